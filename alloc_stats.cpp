@@ -0,0 +1,178 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+using namespace std;
+
+#include "alloc_stats.h"
+
+namespace {
+
+    struct Phase {
+        const char * name;
+        unsigned long count;
+        unsigned long bytes;
+    };
+
+    constexpr int MaxPhases { 8 };
+
+    /* phases are static storage, so that accounting never allocates itself */
+    Phase g_phases[MaxPhases] { { "startup", 0, 0 } };
+    int g_numPhases { 1 };
+    int g_currPhase { 0 };
+
+    /* per thread, so that only the UI thread's are ever read; never reset */
+    /* initial-exec, so that counting from inside malloc never allocates */
+    __attribute__((tls_model("initial-exec"))) thread_local unsigned long g_count { 0 };
+    __attribute__((tls_model("initial-exec"))) thread_local unsigned long g_bytes { 0 };
+
+    /* the totals when the current phase began */
+    unsigned long g_phaseCount { 0 };
+    unsigned long g_phaseBytes { 0 };
+
+    void
+    note(size_t size)
+    {
+        ++g_count;
+        g_bytes += size;
+    }
+
+    void *
+    countedAlloc(size_t size)
+    {
+#ifndef __GLIBC__
+        /* malloc can't be counted here, operator new is all there is */
+        note(size);
+#endif
+        void * p { malloc(size ? size : 1) };
+        if (p == nullptr) {
+            throw bad_alloc {};
+        }
+        return p;
+    }
+
+    void
+    closePhase()
+    {
+        auto& p = g_phases[g_currPhase];
+        p.count += g_count - g_phaseCount;
+        p.bytes += g_bytes - g_phaseBytes;
+        g_phaseCount = g_count;
+        g_phaseBytes = g_bytes;
+    }
+}
+
+#ifdef __GLIBC__
+/*
+ * Replacing the C allocator in the executable catches the libraries too:
+ * Xlib, strdup, the arena's blocks. glibc exports the real one under other
+ * names; operator new lands here through malloc.
+ */
+extern "C" {
+    void * __libc_malloc(size_t);
+    void * __libc_calloc(size_t, size_t);
+    void * __libc_realloc(void *, size_t);
+
+    void *
+    malloc(size_t size)
+    {
+        note(size);
+        return __libc_malloc(size);
+    }
+
+    void *
+    calloc(size_t n, size_t size)
+    {
+        note(n * size);
+        return __libc_calloc(n, size);
+    }
+
+    void *
+    realloc(void * p, size_t size)
+    {
+        note(size);
+        return __libc_realloc(p, size);
+    }
+}
+#endif
+
+void * operator new(size_t size) { return countedAlloc(size); }
+void * operator new[](size_t size) { return countedAlloc(size); }
+void * operator new(size_t size, const nothrow_t&) noexcept
+{
+    try {
+        return countedAlloc(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void * operator new[](size_t size, const nothrow_t& nt) noexcept { return operator new(size, nt); }
+void operator delete(void * p) noexcept { free(p); }
+void operator delete[](void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+void operator delete[](void * p, size_t) noexcept { free(p); }
+
+void
+AllocStats::beginPhase(const char * name)
+{
+    /* a phase begun again, as a resident launcher does, adds up */
+    int i { 0 };
+    while (i < g_numPhases && strcmp(g_phases[i].name, name) != 0) {
+        ++i;
+    }
+    if (i == MaxPhases) {
+        return;
+    }
+    closePhase();
+    if (i == g_numPhases) {
+        g_phases[g_numPhases++].name = name;
+    }
+    g_currPhase = i;
+}
+
+unsigned long
+AllocStats::count()
+{
+    return g_count;
+}
+
+bool
+AllocStats::inPhase(const char * name)
+{
+    return strcmp(g_phases[g_currPhase].name, name) == 0;
+}
+
+void
+AllocStats::report()
+{
+    closePhase();
+    for (int i = 0; i < g_numPhases; ++i) {
+        fprintf(stderr, "alloc-stats: %-12s %8lu allocations %10lu bytes\n",
+                g_phases[i].name, g_phases[i].count, g_phases[i].bytes);
+    }
+}
@@ -0,0 +1,50 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+/*
+ * Heap allocation accounting, enabled at build time with the CMake option
+ * -DALLOC_STATS=ON. When disabled, all methods compile to nothing. Only the
+ * UI thread, the one starting the phases, is accounted for: what the worker
+ * threads allocate is never blamed on a phase or a key press.
+ */
+class AllocStats {
+    public:
+#ifdef ALLOC_STATS
+        static void beginPhase(const char * name);
+        static unsigned long count(); /* since startup, across phases */
+        static bool inPhase(const char * name);
+        static void report();
+#else
+        static void beginPhase(const char *) { }
+        static unsigned long count() { return 0; }
+        static bool inPhase(const char *) { return false; }
+        static void report() { }
+#endif
+};
+
+#endif /* !ALLOCSTATS_H */
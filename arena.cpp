@@ -0,0 +1,83 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+using namespace std;
+
+#include "arena.h"
+
+Arena::Arena(size_t blockSize)
+    : m_blockSize { blockSize },
+      m_blocks { nullptr },
+      m_cur { nullptr },
+      m_end { nullptr }
+{ }
+
+Arena::~Arena()
+{
+    while (m_blocks) {
+        Block * next { m_blocks->next };
+        free(m_blocks);
+        m_blocks = next;
+    }
+}
+
+void *
+Arena::allocate(size_t bytes, size_t alignment)
+{
+    auto cur = reinterpret_cast<uintptr_t>(m_cur);
+    auto aligned = (cur + alignment - 1) & ~(alignment - 1);
+
+    if (m_cur == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(m_end)) {
+        /* oversized requests get a block of their own */
+        size_t size { sizeof(Block) + alignment + (bytes > m_blockSize ? bytes : m_blockSize) };
+        auto block = static_cast<Block *>(malloc(size));
+        if (block == nullptr) {
+            throw bad_alloc {};
+        }
+        block->next = m_blocks;
+        m_blocks = block;
+        m_cur = reinterpret_cast<char *>(block + 1);
+        m_end = reinterpret_cast<char *>(block) + size;
+
+        cur = reinterpret_cast<uintptr_t>(m_cur);
+        aligned = (cur + alignment - 1) & ~(alignment - 1);
+    }
+
+    m_cur = reinterpret_cast<char *>(aligned + bytes);
+    return reinterpret_cast<void *>(aligned);
+}
+
+const char *
+Arena::strdup(const char * s, size_t len)
+{
+    auto p = static_cast<char *>(allocate(len + 1, 1));
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
@@ -0,0 +1,94 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * A monotonic arena for data that lives as long as the launcher. Memory is
+ * carved out of large blocks and only returned all at once, when the arena
+ * is destroyed. The interface mirrors std::pmr::memory_resource.
+ */
+class Arena {
+    public:
+        explicit Arena(size_t blockSize = DefaultBlockSize);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void * allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+        void deallocate(void *, size_t, size_t = alignof(std::max_align_t)) { }
+        bool is_equal(const Arena& other) const { return this == &other; }
+
+        const char * strdup(const char * s, size_t len);
+
+    private:
+        struct Block {
+            Block * next;
+        };
+
+        static constexpr size_t DefaultBlockSize { 64 * 1024 };
+
+        size_t  m_blockSize;
+        Block * m_blocks;
+        char  * m_cur;
+        char  * m_end;
+};
+
+/*
+ * A standard allocator drawing from an Arena, akin to
+ * std::pmr::polymorphic_allocator.
+ */
+template <typename T>
+class ArenaAllocator {
+    public:
+        typedef T value_type;
+
+        ArenaAllocator(Arena& arena) : m_arena { &arena } { }
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : m_arena { other.arena() } { }
+
+        T * allocate(size_t n) { return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T * p, size_t n) { m_arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+        Arena * arena() const { return m_arena; }
+
+    private:
+        Arena * m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena()->is_equal(*b.arena()); }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return !(a == b); }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif /* !ARENA_H */
@@ -23,22 +23,115 @@
  * SUCH DAMAGE.
  */
 
-#include <fstream>
-#include <iostream>
-#include <iterator>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <vector>
 using namespace std;
 
 #include "bookmark.h"
+#include "linereader.h"
+#include "snapshot.h"
 #include "util.h"
 
+Bookmark::Bookmark(Snapshot& snap, Arena& arena)
+    : m_bookmarkFile { bookmarkFile() },
+      m_root { },
+      m_nodes { ArenaAllocator<Node> { arena } },
+      m_edges { ArenaAllocator<Edge> { arena } }
+{
+    auto fingerprint = Snapshot::stamp(m_bookmarkFile);
+
+    /* the snapshot stores the trimmed bookmark lines */
+    ArenaVector<const char *> lines { ArenaAllocator<const char *> { arena } };
+    if (snap.lookup(Snapshot::Sec_Bookmarks, fingerprint, lines)) {
+        build(lines, arena);
+        return;
+    }
+
+    read(lines, arena);
+    build(lines, arena);
+    snap.update(Snapshot::Sec_Bookmarks, fingerprint, lines);
+}
+
 Bookmark::Bookmark()
-    : m_bookmarkFile { Util::getEnv("HOME") + "/.thingylaunch.bookmarks" }
+    : m_bookmarkFile { bookmarkFile() },
+      m_root { },
+      m_nodes { ArenaAllocator<Node> { m_ownArena } },
+      m_edges { ArenaAllocator<Edge> { m_ownArena } }
+{
+    ArenaVector<const char *> lines { ArenaAllocator<const char *> { m_ownArena } };
+    read(lines, m_ownArena);
+    build(lines, m_ownArena);
+}
+
+string
+Bookmark::bookmarkFile()
 {
-    ifstream inFile { m_bookmarkFile };
-    char c;
-    string command;
-    while (inFile >> c >> command)
-        m_bookmarks[c] = command;
+    return Util::getEnv("HOME") + "/.thingylaunch.bookmarks";
+}
+
+void
+Bookmark::read(ArenaVector<const char *>& lines, Arena& arena)
+{
+    LineReader reader { m_bookmarkFile, arena };
+    while (auto line = reader.next()) {
+        while (isspace(static_cast<unsigned char>(*line))) {
+            ++line;
+        }
+        char * e { line + strlen(line) };
+        while (e > line && isspace(static_cast<unsigned char>(e[-1]))) {
+            --e;
+        }
+        *e = '\0';
+        if (*line) {
+            lines.push_back(line);
+        }
+    }
+}
+
+void
+Bookmark::build(const ArenaVector<const char *>& lines, Arena& arena)
+{
+    /* build the trie with ordered children, then lay the edges out flat */
+    vector<map<unsigned char, Cursor>> children(1);
+    m_nodes.push_back(Node { });
+
+    for (auto line : lines) {
+        const char * seq;
+        size_t seqLen;
+        const char * command;
+        if (!parse(line, seq, seqLen, command)) {
+            continue;
+        }
+
+        Cursor node { Root };
+        for (size_t i = 0; i < seqLen; ++i) {
+            auto key = static_cast<unsigned char>(seq[i]);
+            auto iter = children[node].find(key);
+            if (iter == end(children[node])) {
+                iter = children[node].emplace(key, m_nodes.size()).first;
+                m_nodes.push_back(Node { });
+                children.emplace_back();
+            }
+            node = iter->second;
+        }
+
+        m_nodes[node].entry.command = command;
+        m_nodes[node].entry.argv = tokenize(command, arena);
+    }
+
+    for (const auto& c : children[Root]) {
+        m_root[c.first] = c.second;
+    }
+    for (Cursor n = 1; n < m_nodes.size(); ++n) {
+        m_nodes[n].firstEdge = m_edges.size();
+        m_nodes[n].edgeCount = children[n].size();
+        for (const auto& c : children[n]) {
+            m_edges.push_back(Edge { c.first, c.second });
+        }
+    }
 }
 
 Bookmark::~Bookmark()
@@ -46,12 +139,101 @@ Bookmark::~Bookmark()
     // nothing to do...
 }
 
-string
-Bookmark::lookup(char letter)
+bool
+Bookmark::parse(const char * line, const char *& seq, size_t& seqLen, const char *& command)
+{
+    /* a key sequence, blanks, and the command line */
+    seq = line;
+    while (*line && !isspace(static_cast<unsigned char>(*line))) {
+        ++line;
+    }
+    seqLen = line - seq;
+    while (isspace(static_cast<unsigned char>(*line))) {
+        ++line;
+    }
+    command = line;
+
+    return seqLen && *command;
+}
+
+char * const *
+Bookmark::tokenize(const char * command, Arena& arena)
+{
+    /* anything the shell would interpret makes us hand the command over to it */
+    if (strpbrk(command, "|&;<>(){}$`\\\"'*?[]#~=%!")) {
+        return nullptr;
+    }
+
+    size_t len { strlen(command) };
+    auto words = static_cast<char *>(arena.allocate(len + 1, 1));
+    memcpy(words, command, len + 1);
+
+    /* at most one word every other character, plus the terminating nullptr */
+    auto argv = static_cast<char **>(arena.allocate((len / 2 + 2) * sizeof(char *), alignof(char *)));
+    size_t argc { 0 };
+    for (char * p = words; *p; ) {
+        while (isspace(static_cast<unsigned char>(*p))) {
+            *p++ = '\0';
+        }
+        if (*p) {
+            argv[argc++] = p;
+        }
+        while (*p && !isspace(static_cast<unsigned char>(*p))) {
+            ++p;
+        }
+    }
+    argv[argc] = nullptr;
+
+    return argv;
+}
+
+bool
+Bookmark::walk(Cursor& cursor, uint16_t key) const
+{
+    if (key >= sizeof m_root / sizeof m_root[0]) {
+        return false;
+    }
+
+    Cursor next { Root };
+    if (cursor == Root) {
+        next = m_root[key];
+    } else {
+        const auto& node = m_nodes[cursor];
+        auto first = begin(m_edges) + node.firstEdge;
+        auto last = first + node.edgeCount;
+        auto iter = lower_bound(first, last, key, [] (const Edge& e, uint16_t k) { return e.key < k; });
+        if (iter != last && iter->key == key) {
+            next = iter->node;
+        }
+    }
+
+    if (next == Root) {
+        return false;
+    }
+
+    cursor = next;
+    return true;
+}
+
+const Bookmark::Entry *
+Bookmark::entry(Cursor cursor) const
+{
+    const auto& e = m_nodes[cursor].entry;
+    return e.command ? &e : nullptr;
+}
+
+bool
+Bookmark::isLeaf(Cursor cursor) const
+{
+    return cursor == Root ? false : m_nodes[cursor].edgeCount == 0;
+}
+
+void
+Bookmark::commands(vector<const char *>& out) const
 {
-    auto iter = m_bookmarks.find(letter);
-    if (iter == end(m_bookmarks)) {
-        return string();
+    for (const auto& node : m_nodes) {
+        if (node.entry.command) {
+            out.push_back(node.entry.command);
+        }
     }
-    return iter->second;
 }
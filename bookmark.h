@@ -26,21 +26,62 @@
 #ifndef BOOKMARK_H
 #define BOOKMARK_H
 
-#include <map>
+#include <cstdint>
 #include <string>
+#include <vector>
 
+#include "arena.h"
+
+class Snapshot;
+
+/*
+ * Bookmarks are bound to key sequences, e.g. Alt+g followed by b, and stored
+ * in a trie which is walked one node per key press. The root is a table
+ * indexed by key; inner nodes keep their edges sorted by key.
+ */
 class Bookmark {
     public:
-        Bookmark();
+        struct Entry {
+            const char * command;
+            char * const * argv; /* nullptr if the command needs a shell */
+        };
+
+        typedef uint32_t Cursor;
+        static constexpr Cursor Root { 0 };
+
+        Bookmark(Snapshot& snap, Arena& arena);
+        Bookmark(); /* read afresh, into an arena of its own */
         ~Bookmark();
-        std::string lookup(char letter);
+        bool walk(Cursor& cursor, uint16_t key) const;
+        const Entry * entry(Cursor cursor) const;
+        bool isLeaf(Cursor cursor) const;
+        void commands(std::vector<const char *>& out) const;
+
+        static std::string bookmarkFile();
 
     private:
-        std::string getBookmarkFile();
+        struct Node {
+            Entry entry;
+            uint32_t firstEdge;
+            uint32_t edgeCount;
+        };
+
+        struct Edge {
+            unsigned char key;
+            Cursor node;
+        };
+
+        void read(ArenaVector<const char *>& lines, Arena& arena);
+        void build(const ArenaVector<const char *>& lines, Arena& arena);
+        static bool parse(const char * line, const char *& seq, size_t& seqLen, const char *& command);
+        static char * const * tokenize(const char * command, Arena& arena);
 
     private:
         std::string m_bookmarkFile;
-        std::map<char, std::string> m_bookmarks;
+        Arena m_ownArena;
+        Cursor m_root[256];
+        ArenaVector<Node> m_nodes;
+        ArenaVector<Edge> m_edges;
 };
 
 #endif /* !BOOKMARK_H*/
@@ -0,0 +1,159 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdlib>
+using namespace std;
+
+#include "bookmark.h"
+#include "bookmark_reloader.h"
+#include "snapshot.h"
+
+BookmarkReloader::BookmarkReloader(ThreadPool& pool)
+    : m_pool { pool },
+      m_bookmarkFile { Bookmark::bookmarkFile() },
+      m_inotifyFd { -1 },
+      m_linkWatch { -1 },
+      m_targetWatch { -1 },
+      m_stamp { Snapshot::stamp(m_bookmarkFile) },
+      m_ready { nullptr },
+      m_requests { 0 }
+{
+    auto slash = m_bookmarkFile.rfind('/');
+    m_bookmarkName = m_bookmarkFile.substr(slash + 1);
+
+#ifdef HAVE_INOTIFY
+    /* watch the directory, so that editors replacing the file are noticed */
+    m_inotifyFd = inotify_init();
+    if (m_inotifyFd != -1) {
+        fcntl(m_inotifyFd, F_SETFL, fcntl(m_inotifyFd, F_GETFL) | O_NONBLOCK);
+        fcntl(m_inotifyFd, F_SETFD, FD_CLOEXEC);
+        auto mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+        m_linkWatch = inotify_add_watch(m_inotifyFd, m_bookmarkFile.substr(0, slash).c_str(), mask);
+        if (m_linkWatch == -1) {
+            close(m_inotifyFd);
+            m_inotifyFd = -1;
+        }
+
+        /* and the directory of the file a link points to, where it's edited */
+        char target[PATH_MAX];
+        if (m_inotifyFd != -1 && realpath(m_bookmarkFile.c_str(), target) && m_bookmarkFile != target) {
+            string path { target };
+            auto targetSlash = path.rfind('/');
+            m_targetName = path.substr(targetSlash + 1);
+            m_targetWatch = inotify_add_watch(m_inotifyFd, path.substr(0, max<size_t>(targetSlash, 1)).c_str(), mask);
+        }
+    }
+#endif
+}
+
+BookmarkReloader::~BookmarkReloader()
+{
+    m_tasks.wait();
+
+    delete m_ready.exchange(nullptr);
+
+    if (m_inotifyFd != -1) {
+        close(m_inotifyFd);
+    }
+}
+
+int
+BookmarkReloader::fileDescriptor() const
+{
+    return m_inotifyFd;
+}
+
+void
+BookmarkReloader::handleEvents()
+{
+#ifdef HAVE_INOTIFY
+    alignas(inotify_event) char buf[4096];
+    bool changed { false };
+
+    ssize_t n;
+    while ((n = read(m_inotifyFd, buf, sizeof buf)) > 0) {
+        for (char * p = buf; p < buf + n; ) {
+            auto ev = reinterpret_cast<inotify_event *>(p);
+            if (ev->len && ((ev->wd == m_linkWatch && m_bookmarkName == ev->name) ||
+                            (ev->wd == m_targetWatch && m_targetName == ev->name))) {
+                changed = true;
+            }
+            p += sizeof(inotify_event) + ev->len;
+        }
+    }
+
+    if (changed) {
+        request();
+    }
+#endif
+}
+
+void
+BookmarkReloader::check()
+{
+    if (m_inotifyFd == -1) {
+        request();
+    }
+}
+
+Bookmark *
+BookmarkReloader::take()
+{
+    /* what a check found, while another one looks for what changed since */
+    check();
+    return m_ready.exchange(nullptr);
+}
+
+void
+BookmarkReloader::request()
+{
+    /* a reload already under way picks this request up */
+    if (m_requests.fetch_add(1) == 0) {
+        m_pool.submit(ThreadPool::Lane_Background, "bookmarks", [this] { reload(); }, &m_tasks);
+    }
+}
+
+void
+BookmarkReloader::reload()
+{
+    unsigned requests;
+    do {
+        requests = m_requests.load();
+
+        /* a check without inotify only reads a file that changed */
+        auto stamp = Snapshot::stamp(m_bookmarkFile);
+        if (m_inotifyFd != -1 || stamp != m_stamp) {
+            m_stamp = stamp;
+            delete m_ready.exchange(new Bookmark);
+        }
+    } while (m_requests.fetch_sub(requests) != requests);
+}
@@ -0,0 +1,73 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef BOOKMARK_RELOADER_H
+#define BOOKMARK_RELOADER_H
+
+#include <atomic>
+#include <string>
+
+#include "thread_pool.h"
+
+class Bookmark;
+
+/*
+ * Watches the bookmarks file and reparses it as a background task of the
+ * thread pool whenever it changes. The fresh Bookmark is handed over through
+ * an atomic pointer and picked up by the UI thread with take(), so the event
+ * loop never waits for the file to be read. Without inotify, check() and
+ * take() look for changes in the background, for the next take() to pick up.
+ * A symbolic link is followed, and the file it points to watched too.
+ */
+class BookmarkReloader {
+    public:
+        BookmarkReloader(ThreadPool& pool);
+        ~BookmarkReloader();
+        int fileDescriptor() const;
+        void handleEvents();
+        void check(); /* without inotify, when hidden */
+        Bookmark * take();
+
+    private:
+        void request();
+        void reload();
+
+    private:
+        ThreadPool& m_pool;
+        std::string m_bookmarkFile;
+        std::string m_bookmarkName;
+        std::string m_targetName; /* of the file the link points to, if any */
+        int m_inotifyFd;
+        int m_linkWatch;
+        int m_targetWatch;
+        uint64_t m_stamp; /* reload task */
+
+        std::atomic<Bookmark *> m_ready;
+
+        std::atomic<unsigned> m_requests;
+        ThreadPool::Group m_tasks;
+};
+
+#endif /* !BOOKMARK_RELOADER_H */
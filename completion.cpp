@@ -23,115 +23,435 @@
  * SUCH DAMAGE.
  */
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <dirent.h>
-#include <unistd.h>
+#include <poll.h>
 
 #include <algorithm>
-#include <iostream>
+#include <cstring>
 #include <iterator>
-#include <stdexcept>
-#include <sstream>
+#include <thread>
 using namespace std;
 
 #include "completion.h"
+#include "search_key.h"
 #include "util.h"
 
-Completion::Completion()
+namespace {
+    bool
+    byName(const Candidate& a, const Candidate& b)
+    {
+        return strcmp(a.name, b.name) < 0;
+    }
+
+    /* best scores first, alphabetically within the same score */
+    bool
+    byScore(const Candidate& a, const Candidate& b)
+    {
+        return a.score != b.score ? a.score > b.score : strcmp(a.name, b.name) < 0;
+    }
+
+    /* collapse the same name in a set of candidates sorted from first on, keeping its best score */
+    void
+    dedup(vector<Candidate>& candidates, size_t first = 0)
+    {
+        if (candidates.size() <= first) {
+            return;
+        }
+
+        auto out = begin(candidates) + first;
+        for (auto in = out + 1; in < end(candidates); ++in) {
+            if (strcmp(out->name, in->name) == 0) {
+                out->score = max(out->score, in->score);
+            } else {
+                *++out = *in;
+            }
+        }
+        candidates.erase(out + 1, end(candidates));
+    }
+}
+
+Completion::Completion(ThreadPool& pool)
+    : m_pool { pool },
+      m_running { 0 },
+      m_reserved { 0 },
+      m_match { 0 },
+      m_remembering { true },
+      m_rememberedOnly { false },
+      m_shown { 0 },
+      m_queue { [this] { requestIndex(); } },
+      m_indexRequests { 0 },
+      m_index { new Index },
+      m_indexSize { 0 },
+      m_readEpoch { 0 }
 {
-    struct stat sb;
-    uid_t uid { getuid() };
-    gid_t gid { getgid() };
+    /* keep the prefix buffer out of the allocator while typing */
+    m_prefix.reserve(Util::CommandReserve);
+    m_folded.reserve(Util::CommandReserve);
+    m_shownPrefix.reserve(Util::CommandReserve);
+}
 
-    /* get PATH env */
-    string path { Util::getEnv("PATH") };
+Completion::~Completion()
+{
+    stop();
+    m_tasks.wait();
 
-    /* tokenize path */
-    string elem;
-    stringstream ss { path };
-    vector<string> pathElements;
-    while (ss.good()) {
-        getline(ss, elem, ':');
-        pathElements.push_back(move(elem));
+    delete m_index.load();
+    for (const auto& s : m_sources) {
+        for (auto r : s.runs) {
+            delete r;
+        }
+    }
+    for (auto p : m_providers) {
+        delete p;
     }
+}
 
-    for (const auto& pathElem : pathElements) {
+void
+Completion::addProvider(Provider * provider)
+{
+    m_providers.push_back(provider);
+    ++m_running;
 
-        /* open the directory pointed to by path */
-        DIR * dirp { opendir(pathElem.c_str()) };
-        if (dirp == nullptr) {
-            continue;
+    m_pool.submit(ThreadPool::Lane_Background, provider->name(), [this, provider] {
+        m_queue.push(new Batch { provider, Batch::Begin, { }, nullptr });
+        provider->run(m_queue);
+        m_queue.push(new Batch { provider, Batch::End, { }, nullptr });
+    }, &m_tasks);
+}
+
+void
+Completion::stop()
+{
+    m_queue.stop();
+}
+
+void
+Completion::wait()
+{
+    struct pollfd pfd { m_wake.fileDescriptor(), POLLIN, 0 };
+    while (m_running) {
+        poll(&pfd, 1, -1);
+        update();
+    }
+}
+
+int
+Completion::fileDescriptor() const
+{
+    return m_wake.fileDescriptor();
+}
+
+void
+Completion::update()
+{
+    /* drain first, so that a signal for what's pushed from now on isn't lost */
+    m_wake.drain();
+
+    /* make room for any set of matches now, rather than while typing, plus a remembered pick */
+    m_reserved = m_indexSize.load(memory_order_relaxed);
+    m_matches.reserve(m_reserved + 1);
+    m_abbrevs.reserve(m_reserved);
+    m_ranker.reserve(m_reserved);
+
+    Done d;
+    while (m_done.pop(d)) {
+        if (d.ended) {
+            --m_running;
+            if (!d.retired) {
+                d.provider->finished();
+            }
+        }
+        if (d.retired) {
+            /* our matches may still point to its candidates */
+            m_matches.clear();
+            m_shown = 0;
+            m_providers.erase(find(begin(m_providers), end(m_providers), d.provider));
+            delete d.provider;
         }
+    }
+}
+
+void
+Completion::requestIndex()
+{
+    /* an indexing task already under way picks this request up */
+    if (m_indexRequests.fetch_add(1) == 0) {
+        m_pool.submit(ThreadPool::Lane_Background, "index", [this] { index(); }, &m_tasks);
+    }
+}
+
+void
+Completion::index()
+{
+    unsigned requests;
+    do {
+        requests = m_indexRequests.load();
+
+        vector<Done> done;
+        vector<Run *> garbage;
+        for (auto b = m_queue.takeAll(); b; ) {
+            auto source = find_if(begin(m_sources), end(m_sources),
+                    [b] (const Source& s) { return s.provider == b->provider; });
+
+            switch (b->kind) {
+                case Batch::Begin: {
+                    /* a provider of the same name is replaced, once it's done */
+                    auto old = find_if(begin(m_sources), end(m_sources),
+                            [b] (const Source& s) { return strcmp(s.provider->name(), b->provider->name()) == 0; });
+                    if (old != end(m_sources)) {
+                        /* one still running is retired when it ends */
+                        if (old->ended) {
+                            done.push_back(Done { old->provider, false, true });
+                        }
+                        garbage.insert(end(garbage), begin(old->runs), end(old->runs));
+                        m_sources.erase(old);
+                    }
+                    m_sources.push_back(Source { b->provider, { }, false });
+                    break;
+                }
+
+                case Batch::Data:
+                    if (source != end(m_sources) && !b->candidates.empty()) {
+                        auto run = new Run;
+                        run->candidates.swap(b->candidates);
+                        addRun(*source, run, garbage);
+                    }
+                    break;
+
+                case Batch::End:
+                    if (source != end(m_sources)) {
+                        source->ended = true;
+                        done.push_back(Done { b->provider, true, false });
+                    } else {
+                        done.push_back(Done { b->provider, true, true });
+                    }
+                    break;
+            }
 
-        /* traverse directory */
-        struct dirent * dp;
-        while ((dp = readdir(dirp))) {
+            auto next = b->next;
+            delete b;
+            b = next;
+        }
 
-            string currentPath { pathElem + "/" + dp->d_name };
-            /* create a 'path/file' string and check whether we can access meta-information */
-            if (stat(currentPath.c_str(), &sb) == -1) {
-                continue;
+        /* the runs are shared with the previous index, only the list of them is new */
+        auto fresh = new Index;
+        size_t size { 0 };
+        for (const auto& s : m_sources) {
+            for (auto r : s.runs) {
+                fresh->push_back(r);
+                size += r->candidates.size();
             }
+        }
+
+        m_indexSize.store(size, memory_order_relaxed);
+        publish(fresh, garbage);
 
-            /* a regular, executable file*/
-            if (((sb.st_mode & S_IFREG) == S_IFREG) &&
-                ((sb.st_uid == uid && (sb.st_mode & S_IXUSR) == S_IXUSR) ||
-                 (sb.st_gid == gid && (sb.st_mode & S_IXGRP) == S_IXGRP) ||
-                 ((sb.st_mode & S_IXOTH) == S_IXOTH)))
-            {
-                m_elements.push_back(dp->d_name);
+        /* replaced providers can only go once no index refers to them */
+        for (const auto& d : done) {
+            while (!m_done.push(d)) {
+                /* the UI thread is behind, unless it's waiting for us to finish */
+                if (m_queue.stopping()) {
+                    break;
+                }
+                m_wake.signal();
+                this_thread::yield();
             }
         }
-        closedir(dirp);
+        m_wake.signal();
+
+    } while (m_indexRequests.fetch_sub(requests) != requests);
+}
+
+void
+Completion::addRun(Source& source, Run * run, vector<Run *>& garbage)
+{
+    auto& candidates = run->candidates;
+    sort(begin(candidates), end(candidates), byName);
+    dedup(candidates);
+
+    auto& runs = source.runs;
+    while (!runs.empty() && runs.back()->candidates.size() <= 2 * candidates.size()) {
+        const auto& older = runs.back()->candidates;
+        vector<Candidate> merged;
+        merged.reserve(older.size() + candidates.size());
+        merge(begin(older), end(older), begin(candidates), end(candidates), back_inserter(merged), byName);
+        dedup(merged);
+        candidates.swap(merged);
+
+        /* the published index may still be reading the run we merged */
+        garbage.push_back(runs.back());
+        runs.pop_back();
     }
 
-    sort(begin(m_elements), end(m_elements));
+    run->keys.build(candidates, SearchKey::folded);
+    run->initials.build(candidates, SearchKey::initials);
+    if (source.provider->commands()) {
+        run->commands.build(candidates);
+    }
+    runs.push_back(run);
+}
 
-    /* initialize iterator to the begin */
-    m_iter = begin(m_elements);
+void
+Completion::publish(Index * index, vector<Run *>& garbage)
+{
+    auto old = m_index.exchange(index);
+
+    /*
+     * Wait for a grace period: if the UI thread is reading, it might be
+     * reading the old index, so wait for it to be done with it.
+     */
+    auto epoch = m_readEpoch.load();
+    if (epoch & 1) {
+        while (m_readEpoch.load() == epoch) {
+            this_thread::yield();
+        }
+    }
+
+    delete old;
+    for (auto r : garbage) {
+        delete r;
+    }
 }
 
-Completion::~Completion()
+void
+Completion::match()
+{
+    auto key = SearchKey::folded(m_prefix.c_str(), m_folded);
+    auto len = strlen(key);
+
+    /* a single word of two letters or more may be an abbreviation */
+    bool abbrev { len >= 2 && strpbrk(key, "-_. \t") == nullptr };
+
+    /* the remembered pick comes first, whether or not it's been indexed yet */
+    auto picked = m_remembering ? m_memory.lookup(key) : nullptr;
+    m_matches.clear();
+    m_abbrevs.clear();
+    if (picked) {
+        m_matches.push_back(Candidate { picked, 0 });
+    }
+    size_t first { m_matches.size() };
+
+    /* an odd epoch tells the indexing task we're reading */
+    m_readEpoch.fetch_add(1);
+    const auto& index = *m_index.load();
+
+    auto runs = index.size();
+    size_t room { m_reserved };
+    for (auto run : index) {
+        /* a run published since the last update waits for it, rather than be made room for while typing */
+        if (run->candidates.size() > room) {
+            continue;
+        }
+        room -= run->candidates.size();
+        run->keys.match(run->candidates, key, len, m_matches, picked);
+        if (abbrev) {
+            run->initials.match(run->candidates, key, len, m_abbrevs, picked);
+        }
+    }
+
+    m_readEpoch.fetch_add(1, memory_order_release);
+
+    /* by name, for the same name from several runs to keep its best score */
+    sort(begin(m_matches) + first, end(m_matches), byName);
+    if (runs > 1) {
+        dedup(m_matches, first);
+    }
+
+    /* abbreviations come after the names the prefix starts, which they may be among */
+    if (!m_abbrevs.empty()) {
+        m_abbrevs.erase(remove_if(begin(m_abbrevs), end(m_abbrevs), [this, first] (const Candidate& c) {
+            return binary_search(begin(m_matches) + first, end(m_matches), c, byName);
+        }), end(m_abbrevs));
+        if (runs > 1) {
+            sort(begin(m_abbrevs), end(m_abbrevs), byName);
+            dedup(m_abbrevs);
+        }
+        sort(begin(m_abbrevs), end(m_abbrevs), byScore);
+    }
+    sort(begin(m_matches) + first, end(m_matches), byScore);
+    auto prefixed = m_matches.size();
+    m_matches.insert(end(m_matches), begin(m_abbrevs), end(m_abbrevs));
+    m_ranker.rank(m_matches, first, prefixed, m_prefix);
+    m_rememberedOnly = picked && m_matches.size() == 1;
+    m_match = 0;
+    m_shown = 0;
+}
+
+bool
+Completion::resolves(const char * word, size_t len)
 {
-    // nothing to do...
+    m_readEpoch.fetch_add(1);
+    const auto& index = *m_index.load();
+    bool found { any_of(begin(index), end(index), [word, len] (const Run * run) {
+        return run->commands.contains(word, len);
+    }) };
+    m_readEpoch.fetch_add(1, memory_order_release);
+
+    return found;
 }
 
-string
-Completion::next(string command)
+const char *
+Completion::next(const string& command)
 {
     if (command.empty()) {
-        return command;
+        return command.c_str();
     }
 
     if (m_prefix.empty()) {
         m_prefix = command;
+        match();
+    } else if (m_matches.empty() || m_rememberedOnly) {
+        /* more candidates may have been indexed since, the remembered pick has been shown */
+        auto shown = m_match;
+        match();
+        m_match = min(shown, m_matches.size());
     }
 
-    auto matchPrefix = [&command, this] (string e) { return e.compare(0, m_prefix.size(), this->m_prefix) == 0; };
-
-    /* start from where we left off last time */
-    auto iter1 = find_if(m_iter, m_elements.cend(), matchPrefix);
-    if (iter1 != end(m_elements)) {
-        m_iter = iter1 + 1;
-        return *iter1;
+    if (m_matches.empty()) {
+        return command.c_str();
     }
 
-    /* start over */
-    auto iter2 = find_if(begin(m_elements), end(m_elements), matchPrefix);
-    if (iter2 != begin(m_elements)) {
-        m_iter = iter2 + 1;
-        return *iter2;
+    if (m_match == m_matches.size()) {
+        m_match = 0;
     }
 
-    m_iter = begin(m_elements);
-
-    return command;
+    return m_matches[m_match++].name;
 }
 
 void
 Completion::reset()
 {
+    /* what was shown stays around, in case it's picked and completed further */
+    if (m_match) {
+        m_shownPrefix = m_prefix;
+        m_shown = m_match;
+    }
     m_prefix.clear();
-    m_iter = begin(m_elements);
+    m_match = 0;
+}
+
+void
+Completion::chosen(const string& command)
+{
+    const auto& query = m_match ? m_prefix : m_shownPrefix;
+    auto shown = m_match ? m_match : m_shown;
+    m_shown = 0;
+    if (query.empty() || shown == 0 || shown > m_matches.size()) {
+        return;
+    }
+
+    /* the last match shown is the one picked, if the command starts with it */
+    auto picked = m_matches[shown - 1].name;
+    auto len = strlen(picked);
+    if (command.compare(0, len, picked) != 0 || (command.size() > len && command[len] != ' ')) {
+        return;
+    }
+
+    m_ranker.record(query, m_matches, shown);
+    if (m_remembering) {
+        m_memory.record(query, picked);
+    }
+
+    /* the remembered names our matches may point to have moved */
+    m_matches.clear();
+    m_match = 0;
 }
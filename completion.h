@@ -26,21 +26,117 @@
 #ifndef COMPLETION_H
 #define COMPLETION_H
 
+#include <atomic>
 #include <string>
-#include <utility>
 #include <vector>
 
+#include "key_index.h"
+#include "name_set.h"
+#include "pick_memory.h"
+#include "provider.h"
+#include "ranker.h"
+#include "result_queue.h"
+#include "spsc_ring.h"
+#include "thread_pool.h"
+#include "wakeup.h"
+
+/*
+ * Completion candidates are produced by a set of providers, each running as a
+ * background task of the thread pool and streaming batches of candidates to
+ * an indexing task. The indexing task keeps the candidates of each provider
+ * in a few runs sorted by name, of geometrically decreasing sizes: a batch
+ * becomes a run of its own, and runs are merged as soon as one would be at
+ * least half as large as the one before it, so that a provider streaming n
+ * candidates costs O(n log n) overall. Each run is searched through an
+ * index of its names folded to ignore case and diacritics, built along with
+ * it, and through an index of the initials of its names, so that an
+ * abbreviation completes after the names it prefixes. Matches are ranked by
+ * the user's model, if any, and what Tab showed is logged for training it.
+ * What was picked for the same query before comes first, straight from
+ * memory, whether or not the index has been built yet. The commands of runs
+ * of executables and bookmarks are hashed, for what's typed to be checked.
+ *
+ * Indexes are immutable once published, and swapped in RCU-style: the UI
+ * thread reads the current one without ever waiting, and an index is only
+ * freed once the indexing task has seen the UI thread outside of any read
+ * that may have started before the swap. Providers that are done are handed
+ * back to the UI thread through a ring buffer, waking up its event loop.
+ */
 class Completion {
     public:
-        Completion();
+        Completion(ThreadPool& pool);
         ~Completion();
-        std::string next(std::string command);
+        void addProvider(Provider * provider); /* takes ownership, starts it */
+        void stop(); /* providers and indexing give up */
+        void wait();
+        int fileDescriptor() const;
+        void update();
+        const char * next(const std::string& command);
         void reset();
-        
+        void chosen(const std::string& command); /* about to run */
+        bool resolves(const char * word, size_t len);
+        bool indexing() const { return m_running != 0; }
+        /* remembered picks are names of commands, not of what other modes complete */
+        void setRemembering(bool remembering) { m_remembering = remembering; }
+
+    private:
+        struct Run {
+            std::vector<Candidate> candidates;
+            KeyIndex keys;     /* folded names */
+            KeyIndex initials;
+            NameSet commands;  /* of providers whose candidates are commands */
+        };
+        typedef std::vector<const Run *> Index;
+
+        struct Source {
+            Provider * provider;
+            std::vector<Run *> runs;
+            bool ended;
+        };
+
+        struct Done {
+            Provider * provider;
+            bool ended;   /* the provider has delivered all its candidates */
+            bool retired; /* the provider has been replaced and can go */
+        };
+
+        void requestIndex();
+        void index();
+        void addRun(Source& source, Run * run, std::vector<Run *>& garbage);
+        void publish(Index * index, std::vector<Run *>& garbage);
+        void match();
+
     private:
+        ThreadPool& m_pool;
+        ThreadPool::Group m_tasks;
+
+        /* UI thread */
+        std::vector<Provider *> m_providers;
+        size_t m_running;
+        size_t m_reserved; /* candidates the matches have room for */
+        std::vector<Candidate> m_matches;
+        std::vector<Candidate> m_abbrevs;
+        size_t m_match;
         std::string m_prefix;
-        std::vector<std::string> m_elements;
-        std::vector<std::string>::const_iterator m_iter;
+        std::string m_folded; /* the prefix, if folding changes it */
+        Ranker m_ranker;
+        PickMemory m_memory;
+        bool m_remembering;
+        bool m_rememberedOnly; /* the matches are the remembered pick alone */
+        std::string m_shownPrefix; /* of the matches Tab showed, before a reset */
+        size_t m_shown;
+
+        /* indexing task */
+        std::vector<Source> m_sources;
+
+        /* shared */
+        ResultQueue m_queue;
+        std::atomic<unsigned> m_indexRequests;
+        std::atomic<const Index *> m_index;
+        std::atomic<size_t> m_indexSize;
+        std::atomic<unsigned> m_readEpoch;
+        SpscRing<Done, 64> m_done;
+        Wakeup m_wake;
 };
 
 #endif /* !COMPLETION_H */
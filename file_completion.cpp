@@ -0,0 +1,114 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+using namespace std;
+
+#include "file_completion.h"
+#include "util.h"
+
+FileCompletion::FileCompletion(ThreadPool& pool)
+    : m_pool { pool },
+      m_index { new FileIndex },
+      m_rebuilt { false },
+      m_walked { false },
+      m_refreshing { false },
+      m_search { pool, MatchLimit }
+{
+    m_search.setSource(m_index);
+}
+
+FileCompletion::~FileCompletion()
+{
+    /* the walk and the searches read the old index */
+    m_tasks.wait();
+    m_search.setSource(nullptr);
+    delete m_index;
+}
+
+void
+FileCompletion::swap(bool wait)
+{
+    if (m_rebuilt && (wait || m_search.idle()) && m_rebuilt.exchange(false)) {
+        m_search.setSource(nullptr);
+        delete m_index;
+        m_index = new FileIndex;
+        m_search.setSource(m_index);
+    }
+}
+
+void
+FileCompletion::refresh(vector<string> roots)
+{
+    /* one walk at a time, the one under way will do */
+    if (m_refreshing && !m_walked) {
+        return;
+    }
+
+    /* the walk reads the index it replaces, so that must be swapped in now */
+    swap(true);
+    m_walked = false;
+
+    if (roots.empty()) {
+        m_index->roots(roots);
+    }
+    if (roots.empty()) {
+        roots.push_back(Util::getEnv("HOME"));
+    }
+
+    m_refreshing = true;
+    FileIndex::build(roots, m_index, FileIndex::indexFile(), m_pool, m_tasks,
+            [this] (bool built) {
+                /* a walk that failed leaves the current index in place */
+                if (built) {
+                    m_rebuilt.store(true);
+                }
+                m_walked.store(true);
+            });
+}
+
+void
+FileCompletion::wait()
+{
+    m_tasks.wait();
+}
+
+void
+FileCompletion::search(const string& query)
+{
+    swap(false);
+    m_search.search(query);
+}
+
+const char *
+FileCompletion::next(const string& query, bool wait)
+{
+    return m_search.next(query, wait);
+}
+
+void
+FileCompletion::reset()
+{
+    m_search.reset();
+}
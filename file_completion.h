@@ -0,0 +1,70 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef FILE_COMPLETION_H
+#define FILE_COMPLETION_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "file_index.h"
+#include "fuzzy_search.h"
+#include "thread_pool.h"
+
+/*
+ * Completion for the file-search mode: each query is fuzzy-matched against
+ * the file index, and the best matches are offered in turn. The index is
+ * brought up to date in the background and swapped in by the UI thread the
+ * next time a search starts.
+ */
+class FileCompletion {
+    public:
+        FileCompletion(ThreadPool& pool);
+        ~FileCompletion();
+        void refresh(std::vector<std::string> roots = { }); /* empty: those of the current index */
+        void wait();
+        void search(const std::string& query); /* ahead of next(), in the background */
+        const char * next(const std::string& query, bool wait = false);
+        void reset();
+        int fileDescriptor() const { return m_search.fileDescriptor(); }
+        bool update() { return m_search.update(); }
+
+    private:
+        void swap(bool wait); /* else leave it to the next time, while a search reads the index */
+
+    private:
+        static constexpr size_t MatchLimit { 64 };
+
+        ThreadPool& m_pool;
+        ThreadPool::Group m_tasks;
+        FileIndex * m_index;
+        std::atomic<bool> m_rebuilt; /* a new index is ready */
+        std::atomic<bool> m_walked;  /* the walk is over, whether it wrote one or not */
+        bool m_refreshing;
+        FuzzySearch m_search;
+};
+
+#endif /* !FILE_COMPLETION_H */
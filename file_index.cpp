@@ -0,0 +1,490 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+using namespace std;
+
+#include "file_index.h"
+#include "fuzzy.h"
+#include "snapshot.h"
+#include "util.h"
+
+namespace {
+    constexpr char     IndexMagic[8] { 'T', 'L', 'F', 'I', 'L', 'I', 'D', 'X' };
+    constexpr uint32_t IndexVersion  { 1 };
+
+    constexpr uint32_t Entry_Dir     { 1 };
+
+    /* the roots table is padded to keep the tables after it 8-byte aligned */
+    inline uint64_t
+    rootsSize(uint32_t roots)
+    {
+        return (roots + 1) / 2 * 2 * sizeof(uint32_t);
+    }
+
+    /* a match in the file name is worth more than any spread across the path */
+    constexpr int      NameBonus     { 1000 };
+
+    /* a path without repeated or trailing slashes, nor . and .. components */
+    string
+    normalised(const string& path)
+    {
+        vector<string> parts;
+        string::size_type from { 0 };
+        while (from <= path.size()) {
+            auto to = min(path.find('/', from), path.size());
+            auto part = path.substr(from, to - from);
+            if (part == "..") {
+                if (!parts.empty() && parts.back() != "..") {
+                    parts.pop_back();
+                } else if (path[0] != '/') {
+                    parts.push_back(part);
+                }
+            } else if (!part.empty() && part != ".") {
+                parts.push_back(part);
+            }
+            from = to + 1;
+        }
+
+        string out { path[0] == '/' ? "/" : "" };
+        for (const auto& p : parts) {
+            if (!out.empty() && out.back() != '/') {
+                out.append(1, '/');
+            }
+            out.append(p);
+        }
+        return out.empty() ? "." : out;
+    }
+
+    /* whether dir is root or below it */
+    bool
+    within(const string& dir, const string& root)
+    {
+        return dir.compare(0, root.size(), root) == 0 &&
+               (dir.size() == root.size() || root.back() == '/' || dir[root.size()] == '/');
+    }
+}
+
+struct FileIndex::Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t roots;
+    uint32_t dirs;
+    uint32_t reserved;
+    uint64_t entries;
+    uint64_t strings; /* offset of the string pool */
+};
+
+struct FileIndex::DirInfo {
+    uint64_t stamp;
+    uint64_t mask;    /* of the path and all names */
+    uint32_t path;    /* in the string pool */
+    uint32_t first;   /* first entry */
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct FileIndex::Entry {
+    uint64_t mask;
+    uint32_t name;    /* in the string pool */
+    uint32_t flags;
+};
+
+/* the state of a walk, shared by its tasks and freed by the last one */
+struct FileIndex::Walk {
+    struct Dir {
+        string path;
+        uint64_t stamp;
+        vector<pair<string, bool>> entries; /* name, and whether it's a directory */
+    };
+
+    vector<string> roots;
+    const FileIndex * previous;
+    string fileName;
+    ThreadPool& pool;
+    ThreadPool::Group& group;
+    function<void(bool)> done;
+
+    mutex lock;
+    vector<Dir> dirs;
+    atomic<size_t> pending;
+};
+
+FileIndex::FileIndex()
+    : m_map { nullptr },
+      m_mapSize { 0 }
+{
+    int fd { open(indexFile().c_str(), O_RDONLY | O_CLOEXEC) };
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || sb.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        return;
+    }
+
+    void * map { mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+
+    m_map = static_cast<const char *>(map);
+    m_mapSize = sb.st_size;
+
+    /* validate the header, the tables and their references before trusting any offset */
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    uint64_t tables { sizeof(Header) + rootsSize(hdr->roots) +
+                      hdr->dirs * sizeof(DirInfo) + hdr->entries * sizeof(Entry) };
+    bool valid { memcmp(hdr->magic, IndexMagic, sizeof IndexMagic) == 0 &&
+                 hdr->version == IndexVersion &&
+                 hdr->roots < m_mapSize && hdr->dirs < m_mapSize && hdr->entries < m_mapSize &&
+                 tables <= hdr->strings && hdr->strings < m_mapSize &&
+                 m_map[m_mapSize - 1] == '\0' };
+
+    auto poolSize = m_mapSize - hdr->strings;
+    auto roots = reinterpret_cast<const uint32_t *>(m_map + sizeof(Header));
+    for (uint32_t i = 0; valid && i < hdr->roots; ++i) {
+        valid = roots[i] < poolSize;
+    }
+    auto dirs = dirTable(m_map);
+    for (uint32_t i = 0; valid && i < hdr->dirs; ++i) {
+        valid = dirs[i].path < poolSize && dirs[i].first <= hdr->entries &&
+                dirs[i].count <= hdr->entries - dirs[i].first;
+    }
+    auto entries = entryTable(m_map);
+    for (uint64_t i = 0; valid && i < hdr->entries; ++i) {
+        valid = entries[i].name < poolSize;
+    }
+
+    if (!valid) {
+        munmap(map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+}
+
+FileIndex::~FileIndex()
+{
+    if (m_map) {
+        munmap(const_cast<char *>(m_map), m_mapSize);
+    }
+}
+
+const FileIndex::DirInfo *
+FileIndex::dirTable(const char * map)
+{
+    auto hdr = reinterpret_cast<const Header *>(map);
+    return reinterpret_cast<const DirInfo *>(map + sizeof(Header) + rootsSize(hdr->roots));
+}
+
+const FileIndex::Entry *
+FileIndex::entryTable(const char * map)
+{
+    auto hdr = reinterpret_cast<const Header *>(map);
+    return reinterpret_cast<const Entry *>(dirTable(map) + hdr->dirs);
+}
+
+string
+FileIndex::indexFile()
+{
+    return Util::getEnv("HOME") + "/.thingylaunch.files";
+}
+
+void
+FileIndex::roots(vector<string>& out) const
+{
+    if (m_map == nullptr) {
+        return;
+    }
+
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    auto roots = reinterpret_cast<const uint32_t *>(m_map + sizeof(Header));
+    for (uint32_t i = 0; i < hdr->roots; ++i) {
+        out.push_back(m_map + hdr->strings + roots[i]);
+    }
+}
+
+const FileIndex::DirInfo *
+FileIndex::find(const string& dir) const
+{
+    if (m_map == nullptr) {
+        return nullptr;
+    }
+
+    /* directories are sorted by path */
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    auto first = dirTable(m_map);
+    auto last = first + hdr->dirs;
+    auto pool = m_map + hdr->strings;
+    auto iter = lower_bound(first, last, dir.c_str(),
+            [pool] (const DirInfo& d, const char * path) { return strcmp(pool + d.path, path) < 0; });
+    return iter != last && dir == pool + iter->path ? iter : nullptr;
+}
+
+size_t
+FileIndex::items() const
+{
+    return m_map ? reinterpret_cast<const Header *>(m_map)->dirs : 0;
+}
+
+void
+FileIndex::score(const Fuzzy& query, size_t first, size_t last, FuzzySearch::TopK& top,
+        const atomic<bool>& cancelled) const
+{
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    auto dirs = dirTable(m_map);
+    auto entries = entryTable(m_map);
+    auto pool = m_map + hdr->strings;
+    auto qmask = query.mask();
+
+    for (auto d = first; d < last && !cancelled.load(memory_order_relaxed); ++d) {
+        const auto& dir = dirs[d];
+        if (qmask & ~dir.mask) {
+            continue;
+        }
+
+        /* whatever the directory path doesn't match must be in the name */
+        auto k = query.consume(pool + dir.path);
+        auto restMask = query.mask(k);
+
+        for (uint32_t e = dir.first; e < dir.first + dir.count; ++e) {
+            const auto& entry = entries[e];
+            auto name = pool + entry.name;
+
+            int score { -1 };
+            if ((qmask & ~entry.mask) == 0) {
+                score = query.score(name);
+                if (score >= 0) {
+                    score += NameBonus;
+                }
+            }
+            if (score < 0 && k && (restMask & ~entry.mask) == 0) {
+                score = query.score(name, k);
+                if (score >= 0) {
+                    score += k;
+                }
+            }
+            if (score < 0) {
+                continue;
+            }
+
+            /* shorter names first, among equal matches */
+            score = score * 64 - min<int>(strlen(name), 63);
+            top.add(FuzzySearch::Hit { score, static_cast<uint32_t>(d), e });
+        }
+    }
+}
+
+string
+FileIndex::text(const FuzzySearch::Hit& hit) const
+{
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    auto dirs = dirTable(m_map);
+    auto entries = entryTable(m_map);
+    auto pool = m_map + hdr->strings;
+
+    string path { pool + dirs[hit.item].path };
+    if (path.back() != '/') {
+        path.append(1, '/');
+    }
+    return path.append(pool + entries[hit.sub].name);
+}
+
+void
+FileIndex::build(const vector<string>& given, const FileIndex * previous, const string& fileName,
+        ThreadPool& pool, ThreadPool::Group& group, function<void(bool)> done)
+{
+    /* the same directory given twice, or one below another root, would be walked twice */
+    vector<string> sorted;
+    for (const auto& r : given) {
+        if (!r.empty()) {
+            sorted.push_back(normalised(r));
+        }
+    }
+    sort(begin(sorted), end(sorted)); /* a directory before those below it */
+    vector<string> roots;
+    for (const auto& r : sorted) {
+        if (none_of(begin(roots), end(roots), [&r] (const string& root) { return within(r, root); })) {
+            roots.push_back(r);
+        }
+    }
+
+    auto walk = new Walk { roots, previous, fileName, pool, group, move(done), { }, { }, { roots.size() } };
+    if (roots.empty()) {
+        write(walk);
+        return;
+    }
+
+    for (const auto& root : roots) {
+        pool.submit(ThreadPool::Lane_Background, "file-walk", [walk, root] { visit(walk, root); }, &group);
+    }
+}
+
+void
+FileIndex::visit(Walk * walk, string path)
+{
+    /* stamp before reading, a change while we read makes the entry stale rather than wrong */
+    Walk::Dir dir { path, Snapshot::stamp(path), { } };
+
+    const DirInfo * old { walk->previous ? walk->previous->find(path) : nullptr };
+    if (old && old->stamp == dir.stamp) {
+        /* unchanged since the previous index, no need to read it */
+        auto map = walk->previous->m_map;
+        auto hdr = reinterpret_cast<const Header *>(map);
+        auto entries = entryTable(map);
+        for (uint32_t e = old->first; e < old->first + old->count; ++e) {
+            dir.entries.emplace_back(map + hdr->strings + entries[e].name, entries[e].flags & Entry_Dir);
+        }
+    } else if (DIR * dirp = opendir(path.c_str())) {
+        string child;
+        struct dirent * dp;
+        while ((dp = readdir(dirp))) {
+            /* hidden files and directories stay out, and so do . and .. */
+            if (dp->d_name[0] == '.') {
+                continue;
+            }
+
+            /* symbolic links to directories are not followed */
+            bool isDir { dp->d_type == DT_DIR };
+            if (dp->d_type == DT_UNKNOWN) {
+                struct stat sb;
+                child.assign(path).append(1, '/').append(dp->d_name);
+                isDir = lstat(child.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode);
+            }
+            dir.entries.emplace_back(dp->d_name, isDir);
+        }
+        closedir(dirp);
+        sort(begin(dir.entries), end(dir.entries));
+    }
+
+    /* account for the subdirectories before this one is done, so that the count never drops to 0 early */
+    for (const auto& e : dir.entries) {
+        if (e.second) {
+            string child { path };
+            if (child.back() != '/') {
+                child.append(1, '/');
+            }
+            child.append(e.first);
+            walk->pending.fetch_add(1);
+            walk->pool.submit(ThreadPool::Lane_Background, "file-walk",
+                    [walk, child] { visit(walk, child); }, &walk->group);
+        }
+    }
+
+    {
+        lock_guard<mutex> lock { walk->lock };
+        walk->dirs.push_back(move(dir));
+    }
+
+    if (walk->pending.fetch_sub(1) == 1) {
+        write(walk);
+    }
+}
+
+void
+FileIndex::write(Walk * walk)
+{
+    auto& walked = walk->dirs;
+    sort(begin(walked), end(walked), [] (const Walk::Dir& a, const Walk::Dir& b) { return a.path < b.path; });
+
+    vector<uint32_t> roots;
+    vector<DirInfo> dirs;
+    vector<Entry> entries;
+    string pool;
+
+    auto intern = [&pool] (const char * s) {
+        uint32_t off = pool.size();
+        pool.append(s, strlen(s) + 1);
+        return off;
+    };
+
+    for (const auto& r : walk->roots) {
+        roots.push_back(intern(r.c_str()));
+    }
+    for (const auto& d : walked) {
+        DirInfo info { d.stamp, Fuzzy::charMask(d.path.c_str()), intern(d.path.c_str()),
+                       static_cast<uint32_t>(entries.size()), 0, 0 };
+        for (const auto& e : d.entries) {
+            Entry entry { Fuzzy::charMask(e.first.c_str()), intern(e.first.c_str()), e.second ? Entry_Dir : 0 };
+            info.mask |= entry.mask;
+            entries.push_back(entry);
+        }
+        info.count = entries.size() - info.first;
+        dirs.push_back(info);
+    }
+    if (pool.empty()) {
+        pool.push_back('\0');
+    }
+
+    /* offsets are 32 bits wide, an index that outgrows them is not written at all */
+    bool fits { pool.size() <= UINT32_MAX && entries.size() <= UINT32_MAX };
+    roots.resize(rootsSize(roots.size()) / sizeof(uint32_t));
+
+    Header hdr;
+    memcpy(hdr.magic, IndexMagic, sizeof IndexMagic);
+    hdr.version = IndexVersion;
+    hdr.roots = walk->roots.size();
+    hdr.dirs = dirs.size();
+    hdr.reserved = 0;
+    hdr.entries = entries.size();
+    hdr.strings = sizeof hdr + rootsSize(hdr.roots) +
+                  dirs.size() * sizeof(DirInfo) + entries.size() * sizeof(Entry);
+
+    /* searches map the index whole, so a new one only ever replaces it by a rename */
+    string tmpFile;
+    FILE * out { fits ? Util::createTemp(walk->fileName, tmpFile) : nullptr };
+    bool ok { out != nullptr };
+    if (ok) {
+        ok = fwrite(&hdr, sizeof hdr, 1, out) == 1 &&
+             fwrite(roots.data(), sizeof(uint32_t), roots.size(), out) == roots.size() &&
+             fwrite(dirs.data(), sizeof(DirInfo), dirs.size(), out) == dirs.size() &&
+             fwrite(entries.data(), sizeof(Entry), entries.size(), out) == entries.size() &&
+             fwrite(pool.data(), 1, pool.size(), out) == pool.size();
+        ok = fclose(out) == 0 && ok;
+        ok = ok && rename(tmpFile.c_str(), walk->fileName.c_str()) == 0;
+        if (!ok) {
+            unlink(tmpFile.c_str());
+        }
+    }
+
+    auto done = move(walk->done);
+    delete walk;
+    if (done) {
+        done(ok);
+    }
+}
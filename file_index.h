@@ -0,0 +1,88 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "fuzzy_search.h"
+#include "thread_pool.h"
+
+/*
+ * A per-user, mmap'ed index of the files below a set of root directories, for
+ * the file-search mode. As in mlocate, paths are grouped by directory: each
+ * directory path is stored once, followed by the names it holds, and tagged
+ * with its stamp so that an update only reads the directories that changed.
+ * Directories and names carry a bitmask of the characters they contain, so
+ * that a search skips most of them without looking at their strings. Its
+ * items, for a search, are the directories. Unlike the older locate, paths
+ * aren't front-compressed against the one before, so that a search slice
+ * can start reading at any directory.
+ */
+class FileIndex : public FuzzySearch::Source {
+    public:
+        FileIndex();
+        virtual ~FileIndex();
+        void roots(std::vector<std::string>& out) const;
+
+        virtual size_t items() const;
+        virtual void score(const Fuzzy& query, size_t first, size_t last, FuzzySearch::TopK& top,
+                const std::atomic<bool>& cancelled) const;
+        virtual std::string text(const FuzzySearch::Hit& hit) const;
+
+        static std::string indexFile();
+
+        /*
+         * Walk the roots on the pool, one task per directory, and write a new
+         * index reusing the directories of the previous one that are unchanged.
+         * The previous index must stay around until done is called, from the
+         * task that finished last.
+         */
+        static void build(const std::vector<std::string>& roots, const FileIndex * previous,
+                const std::string& fileName, ThreadPool& pool, ThreadPool::Group& group,
+                std::function<void(bool)> done);
+
+    private:
+        struct Header;
+        struct DirInfo;
+        struct Entry;
+        struct Walk;
+
+        const DirInfo * find(const std::string& dir) const;
+        static const DirInfo * dirTable(const char * map);
+        static const Entry * entryTable(const char * map);
+        static void visit(Walk * walk, std::string path);
+        static void write(Walk * walk);
+
+    private:
+        const char * m_map;
+        size_t m_mapSize;
+};
+
+#endif /* !FILE_INDEX_H */
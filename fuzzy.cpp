@@ -0,0 +1,109 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cctype>
+using namespace std;
+
+#include "fuzzy.h"
+
+namespace {
+    inline uint64_t
+    bit(char c)
+    {
+        return 1ULL << (tolower(static_cast<unsigned char>(c)) & 63);
+    }
+
+    inline bool
+    boundary(char c)
+    {
+        return c == '/' || c == '-' || c == '_' || c == '.' || c == ' ';
+    }
+}
+
+Fuzzy::Fuzzy(const string& query)
+    : m_query { query },
+      m_fold { none_of(begin(query), end(query), [] (char c) { return isupper(static_cast<unsigned char>(c)); }) },
+      m_masks(query.size() + 1, 0)
+{
+    for (size_t i = query.size(); i > 0; --i) {
+        m_masks[i - 1] = m_masks[i] | bit(query[i - 1]);
+    }
+}
+
+Fuzzy::~Fuzzy()
+{
+    // nothing to do...
+}
+
+uint64_t
+Fuzzy::charMask(const char * s)
+{
+    uint64_t mask { 0 };
+    for (; *s; ++s) {
+        mask |= bit(*s);
+    }
+    return mask;
+}
+
+inline bool
+Fuzzy::same(char c, char q) const
+{
+    return c == q || (m_fold && tolower(static_cast<unsigned char>(c)) == q);
+}
+
+int
+Fuzzy::score(const char * s, size_t from) const
+{
+    auto q = m_query.data();
+    auto qlen = m_query.size();
+
+    int score { 0 };
+    size_t i { from };
+    char prev { '/' };
+    bool run { false };
+    for (; *s && i < qlen; prev = *s++) {
+        if (same(*s, q[i])) {
+            score += 1 + (run ? 2 : 0) + (boundary(prev) ? 3 : 0);
+            run = true;
+            ++i;
+        } else {
+            run = false;
+        }
+    }
+    return i == qlen ? score : -1;
+}
+
+size_t
+Fuzzy::consume(const char * s) const
+{
+    size_t i { 0 };
+    for (; *s && i < m_query.size(); ++s) {
+        if (same(*s, m_query[i])) {
+            ++i;
+        }
+    }
+    return i;
+}
@@ -0,0 +1,69 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * A query matched as a subsequence, e.g. "fxprf" in "firefox-preferences".
+ * Consecutive characters and characters starting a word score higher. A
+ * query in lower case matches either case. Strings can be rejected early
+ * by comparing the characters they contain with those of the query, as
+ * bitmasks.
+ */
+class Fuzzy {
+    public:
+        Fuzzy(const std::string& query);
+        ~Fuzzy();
+
+        const std::string& query() const { return m_query; }
+        size_t size() const { return m_query.size(); }
+
+        /* the characters of the query from the given position on */
+        uint64_t mask(size_t from = 0) const { return m_masks[from]; }
+
+        /* the score of the query from the given position on as a subsequence of s, or -1 */
+        int score(const char * s, size_t from = 0) const;
+
+        /* how much of the query s consumes, matching greedily */
+        size_t consume(const char * s) const;
+
+        /* the characters in s, case-folded; collisions only make the filter weaker */
+        static uint64_t charMask(const char * s);
+
+    private:
+        bool same(char c, char q) const;
+
+    private:
+        std::string m_query;
+        bool m_fold;
+        std::vector<uint64_t> m_masks; /* of each suffix of the query */
+};
+
+#endif /* !FUZZY_H */
@@ -0,0 +1,241 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+using namespace std;
+
+#include "fuzzy_search.h"
+
+FuzzySearch::TopK::TopK(size_t limit)
+    : m_limit { limit }
+{
+    m_hits.reserve(limit + 1);
+}
+
+bool
+FuzzySearch::TopK::better(const Hit& a, const Hit& b)
+{
+    /* a total order, so that results don't depend on how the items were sliced */
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.item != b.item ? a.item < b.item : a.sub < b.sub;
+}
+
+void
+FuzzySearch::TopK::add(const Hit& hit)
+{
+    if (m_hits.size() == m_limit) {
+        if (m_limit == 0 || !better(hit, m_hits.front())) {
+            return;
+        }
+        pop_heap(begin(m_hits), end(m_hits), better);
+        m_hits.back() = hit;
+    } else {
+        m_hits.push_back(hit);
+    }
+    push_heap(begin(m_hits), end(m_hits), better);
+}
+
+FuzzySearch::FuzzySearch(ThreadPool& pool, size_t limit)
+    : m_pool { pool },
+      m_limit { limit },
+      m_source { nullptr },
+      m_run { nullptr },
+      m_match { 0 },
+      m_searched { false },
+      m_complete { false },
+      m_waiting { false }
+{ }
+
+FuzzySearch::~FuzzySearch()
+{
+    cancel();
+    m_slices.wait();
+}
+
+void
+FuzzySearch::release(Run * run)
+{
+    if (run->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete run;
+    }
+}
+
+void
+FuzzySearch::cancel()
+{
+    if (m_run) {
+        /* slices not yet started give up at once, those under way soon after */
+        m_run->cancelled.store(true, memory_order_relaxed);
+        release(m_run);
+        m_run = nullptr;
+    }
+}
+
+void
+FuzzySearch::setSource(const Source * source)
+{
+    cancel();
+    m_slices.wait();
+    m_source = source;
+    reset();
+}
+
+bool
+FuzzySearch::idle()
+{
+    return m_slices.idle();
+}
+
+void
+FuzzySearch::search(const string& query)
+{
+    if (m_source == nullptr || query.empty()) {
+        return;
+    }
+
+    /* the same query over the same items is already under way, or done */
+    auto items = m_source->items();
+    if (m_run && m_run->query.query() == query && m_run->items == items) {
+        return;
+    }
+    cancel();
+
+    auto slices = min(max<size_t>(items / MinSlice, 1), m_pool.workers() * SlicesPerWorker);
+    auto run = new Run { query, items, slices };
+    run->slices.reserve(slices);
+    for (size_t i = 0; i < slices; ++i) {
+        run->slices.emplace_back(m_limit);
+    }
+    for (size_t i = 0; i < slices; ++i) {
+        auto first = items * i / slices;
+        auto last = items * (i + 1) / slices;
+        auto source = m_source;
+        auto wake = &m_wake;
+        m_pool.submit(ThreadPool::Lane_Interactive, "fuzzy-search", [run, source, first, last, i, wake] {
+            if (!run->cancelled.load(memory_order_relaxed)) {
+                source->score(run->query, first, last, run->slices[i], run->cancelled);
+            }
+            run->done[i].store(true, memory_order_release);
+            if (!run->cancelled.load(memory_order_relaxed)) {
+                wake->signal();
+            }
+            release(run);
+        }, &m_slices);
+    }
+    m_run = run;
+}
+
+void
+FuzzySearch::merge()
+{
+    /* the best of the best of each slice done */
+    vector<Hit> hits;
+    m_complete = true;
+    for (size_t i = 0; i < m_run->slices.size(); ++i) {
+        if (m_run->done[i].load(memory_order_acquire)) {
+            const auto& s = m_run->slices[i];
+            hits.insert(end(hits), begin(s.m_hits), end(s.m_hits));
+        } else {
+            m_complete = false;
+        }
+    }
+    auto n = min(hits.size(), m_limit);
+    partial_sort(begin(hits), begin(hits) + n, end(hits), TopK::better);
+
+    m_matches.clear();
+    for (size_t i = 0; i < n; ++i) {
+        m_matches.push_back(m_source->text(hits[i]));
+    }
+}
+
+const char *
+FuzzySearch::next(const string& query, bool wait)
+{
+    if (query.empty()) {
+        return query.c_str();
+    }
+
+    if (!m_searched) {
+        search(query);
+        if (m_run == nullptr) {
+            return query.c_str();
+        }
+
+        /* abandoned searches stop short, waiting for them too is no loss */
+        if (wait) {
+            m_slices.wait();
+        }
+        merge();
+        m_match = 0;
+        m_searched = true;
+    }
+
+    if (m_matches.empty()) {
+        m_waiting = !m_complete;
+        return query.c_str();
+    }
+
+    if (m_match == m_matches.size()) {
+        m_match = 0;
+    }
+
+    return m_matches[m_match++].c_str();
+}
+
+void
+FuzzySearch::reset()
+{
+    /* the search itself is kept, the same query may come back */
+    m_matches.clear();
+    m_match = 0;
+    m_searched = false;
+    m_waiting = false;
+}
+
+int
+FuzzySearch::fileDescriptor() const
+{
+    return m_wake.fileDescriptor();
+}
+
+bool
+FuzzySearch::update()
+{
+    m_wake.drain();
+    if (!m_searched || m_complete || m_run == nullptr) {
+        return false;
+    }
+
+    /* what was offered stays offered, the next Tab goes on from there */
+    auto shown = m_match;
+    merge();
+    m_match = min(shown, m_matches.size());
+
+    bool found { m_waiting && !m_matches.empty() };
+    m_waiting = m_waiting && !found;
+    return found;
+}
@@ -0,0 +1,132 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef FUZZY_SEARCH_H
+#define FUZZY_SEARCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fuzzy.h"
+#include "thread_pool.h"
+#include "wakeup.h"
+
+/*
+ * Fuzzy search over sources too large to be scanned on the UI thread, such
+ * as the file index or the lines read in dmenu mode. A search splits the
+ * items of its source into slices, several per worker so that stealing can
+ * even out their cost, and scores each slice on the interactive lane into
+ * a top-K heap of its own. Searches are started as the query is typed, each
+ * one abandoning the one before, so that by the time Tab is hit the results
+ * are usually there. If they aren't, Tab gets the heaps of the slices done so
+ * far, merged, and the rest are merged in as the slices wake up the event
+ * loop. Abandoning a search never waits for it: its slices see it cancelled
+ * and stop, and the last one to finish frees it.
+ */
+class FuzzySearch {
+    public:
+        struct Hit {
+            int score;
+            uint32_t item;
+            uint32_t sub;  /* within the item, if the source has such a thing */
+        };
+
+        /* the best hits seen, kept in a heap with the worst one on top */
+        class TopK {
+            public:
+                TopK(size_t limit);
+                void add(const Hit& hit);
+                /* a better score, then the earlier item, wins */
+                static bool better(const Hit& a, const Hit& b);
+
+            private:
+                friend class FuzzySearch;
+                size_t m_limit;
+                std::vector<Hit> m_hits;
+        };
+
+        /*
+         * Items are scored in slices, from any thread, while the source stays
+         * unchanged below items(); a slice returns early once cancelled.
+         */
+        struct Source {
+            virtual ~Source() { }
+            virtual size_t items() const =0;
+            virtual void score(const Fuzzy& query, size_t first, size_t last, TopK& top,
+                    const std::atomic<bool>& cancelled) const =0;
+            virtual std::string text(const Hit& hit) const =0;
+        };
+
+        FuzzySearch(ThreadPool& pool, size_t limit);
+        ~FuzzySearch();
+        void setSource(const Source * source); /* after waiting for any search of the previous one */
+        bool idle(); /* no search reads the source any more, setSource won't wait */
+        void search(const std::string& query); /* in the background */
+        /* wait: for every slice, as replays must, rather than take those done */
+        const char * next(const std::string& query, bool wait = false);
+        void reset();
+        int fileDescriptor() const;
+        bool update(); /* merge the slices done since, true if next() has a match where it had none */
+
+    private:
+        /* shared by the slices and the search, the last one to let go frees it */
+        struct Run {
+            Run(const std::string& query, size_t items, size_t slices)
+                : query { query }, items { items }, done(slices), cancelled { false }, refs { slices + 1 } { }
+
+            Fuzzy query;
+            size_t items;
+            std::vector<TopK> slices;
+            std::vector<std::atomic<bool>> done; /* a slice's heap can be read */
+            std::atomic<bool> cancelled;
+            std::atomic<size_t> refs;
+        };
+
+        void cancel();
+        void merge();
+        static void release(Run * run);
+
+    private:
+        /* slices per worker, and the least items worth a slice */
+        static constexpr size_t SlicesPerWorker { 4 };
+        static constexpr size_t MinSlice { 1024 };
+
+        ThreadPool& m_pool;
+        size_t m_limit;
+        const Source * m_source;
+        Run * m_run;
+        ThreadPool::Group m_slices; /* of every search, abandoned ones included */
+        Wakeup m_wake;
+
+        std::vector<std::string> m_matches;
+        size_t m_match;
+        bool m_searched;
+        bool m_complete; /* the matches are merged from every slice */
+        bool m_waiting;  /* next() found nothing, and slices are still scoring */
+};
+
+#endif /* !FUZZY_SEARCH_H */
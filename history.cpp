@@ -23,25 +23,31 @@
  * SUCH DAMAGE.
  */
 
-#include <fstream>
-#include <iostream>
-#include <iterator>
+#include <cstdio>
 using namespace std;
 
 #include "history.h"
+#include "linereader.h"
+#include "snapshot.h"
 #include "util.h"
 
-History::History()
-    : m_historyFile { Util::getEnv("HOME") + "/.thingylaunch.history" }
+History::History(Snapshot& snap, Arena& arena)
+    : m_historyFile { Util::getEnv("HOME") + "/.thingylaunch.history" },
+      m_snap { snap },
+      m_arena { arena },
+      m_elements { ArenaAllocator<const char *> { arena } }
 {
-    ifstream inFile { m_historyFile };
-    string line;
+    auto fingerprint = Snapshot::stamp(m_historyFile);
 
-    while (inFile.good()) {
-        getline(inFile, line);
-        if (!line.empty()) {
-            m_elements.push_back(move(line));
+    if (!m_snap.lookup(Snapshot::Sec_History, fingerprint, m_elements)) {
+        LineReader reader { m_historyFile, m_arena };
+        while (auto line = reader.next()) {
+            if (*line) {
+                m_elements.push_back(line);
+            }
         }
+
+        m_snap.update(Snapshot::Sec_History, fingerprint, m_elements);
     }
 
     m_iter = begin(m_elements) - 1;
@@ -52,11 +58,11 @@ History::~History()
     // nothing to do...
 }
 
-string
+const char *
 History::next()
 {
     if (m_elements.empty()) {
-        return string();
+        return "";
     }
 
     if (m_iter >= end(m_elements) - 1) {
@@ -68,11 +74,11 @@ History::next()
     return *m_iter;
 }
 
-string
+const char *
 History::prev()
 {
     if (m_elements.empty()) {
-        return string();
+        return "";
     }
 
     if (m_iter <= begin(m_elements)) {
@@ -85,12 +91,29 @@ History::prev()
 }
 
 void
-History::save(string entry)
+History::save(const string& entry)
 {
-    ofstream outFile { m_historyFile };
-    copy (begin(m_elements), end(m_elements),
-            ostream_iterator<string>(outFile, "\n"));
-    if (!m_elements.size() || *(end(m_elements) - 1) != entry) {
-        outFile << entry;
+    if (!m_elements.size() || entry != *(end(m_elements) - 1)) {
+        m_elements.push_back(m_arena.strdup(entry.c_str(), entry.size()));
+    }
+
+    FILE * outFile { fopen(m_historyFile.c_str(), "w") };
+    if (outFile == nullptr) {
+        return;
     }
+    for (auto e : m_elements) {
+        fputs(e, outFile);
+        fputc('\n', outFile);
+    }
+    fclose(outFile);
+
+    /* keep the snapshot in sync with what we've just written */
+    m_snap.update(Snapshot::Sec_History, Snapshot::stamp(m_historyFile), m_elements);
+    m_iter = begin(m_elements) - 1;
+}
+
+const ArenaVector<const char *>&
+History::elements() const
+{
+    return m_elements;
 }
@@ -29,18 +29,25 @@
 #include <string>
 #include <vector>
 
+#include "arena.h"
+
+class Snapshot;
+
 class History {
     public:
-        History();
+        History(Snapshot& snap, Arena& arena);
         ~History();
-        std::string next();
-        std::string prev();
-        void save(std::string entry);
+        const char * next();
+        const char * prev();
+        void save(const std::string& entry);
+        const ArenaVector<const char *>& elements() const;
 
     private:
         std::string m_historyFile;
-        std::vector<std::string> m_elements;
-        std::vector<std::string>::const_iterator m_iter;
+        Snapshot& m_snap;
+        Arena& m_arena;
+        ArenaVector<const char *> m_elements;
+        ArenaVector<const char *>::const_iterator m_iter;
 };
 
 #endif /* !HISTORY_H */
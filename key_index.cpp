@@ -0,0 +1,83 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+#include "key_index.h"
+
+KeyIndex::KeyIndex()
+{ }
+
+KeyIndex::~KeyIndex()
+{
+    // nothing to do...
+}
+
+void
+KeyIndex::build(const vector<Candidate>& candidates, KeyFunction key)
+{
+    /* lay the copied keys out first, the pool doesn't move once we point into it */
+    vector<pair<size_t, uint32_t>> copied; /* offset in the pool, of the key */
+    string buf;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        auto k = key(candidates[i].name, buf);
+        if (k == nullptr) {
+            continue;
+        }
+        if (k != candidates[i].name) {
+            copied.emplace_back(m_pool.size(), m_keys.size());
+            m_pool.append(k, strlen(k) + 1);
+        }
+        m_keys.push_back(Candidate { k, static_cast<uint32_t>(i) });
+    }
+    for (const auto& c : copied) {
+        m_keys[c.second].name = m_pool.data() + c.first;
+    }
+
+    /* keys that are all names are already in order */
+    auto byKey = [] (const Candidate& a, const Candidate& b) {
+        auto cmp = strcmp(a.name, b.name);
+        return cmp != 0 ? cmp < 0 : a.score < b.score;
+    };
+    if (!is_sorted(begin(m_keys), end(m_keys), byKey)) {
+        sort(begin(m_keys), end(m_keys), byKey);
+    }
+    m_index.build(m_keys);
+}
+
+void
+KeyIndex::match(const vector<Candidate>& candidates, const char * key, size_t len,
+        vector<Candidate>& out, const char * skip) const
+{
+    auto r = m_index.range(m_keys, key, len);
+    for (auto i = r.first; i < r.second; ++i) {
+        const auto& c = candidates[m_keys[i].score];
+        if (skip == nullptr || strcmp(c.name, skip) != 0) {
+            out.push_back(c);
+        }
+    }
+}
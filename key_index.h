@@ -0,0 +1,61 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef KEY_INDEX_H
+#define KEY_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include "prefix_index.h"
+#include "provider.h"
+
+/*
+ * Candidates searched by a key derived from their names, such as their
+ * folded names or their initials. The keys are sorted and looked up through
+ * a prefix index; those equal to the names they come from aren't copied.
+ */
+class KeyIndex {
+    public:
+        /* the key of a name, either the name itself or in buf, or nullptr for none */
+        typedef const char * (*KeyFunction)(const char * name, std::string& buf);
+
+        KeyIndex();
+        KeyIndex(const KeyIndex&) = delete;
+        KeyIndex& operator=(const KeyIndex&) = delete;
+        ~KeyIndex();
+
+        void build(const std::vector<Candidate>& candidates, KeyFunction key);
+        /* append the candidates whose key starts with the given one, but for skip */
+        void match(const std::vector<Candidate>& candidates, const char * key, size_t len,
+                std::vector<Candidate>& out, const char * skip = nullptr) const;
+
+    private:
+        std::string m_pool;
+        std::vector<Candidate> m_keys; /* each scored with its candidate */
+        PrefixIndex m_index;
+};
+
+#endif /* !KEY_INDEX_H */
@@ -0,0 +1,130 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+using namespace std;
+
+#include "line_stream.h"
+
+LineStream::LineStream(int fd)
+    : m_fd { fd },
+      m_count { 0 }
+{ }
+
+LineStream::~LineStream()
+{
+    for (size_t b = 0; b * BlockSize < m_count; ++b) {
+        delete [] m_blocks[b];
+    }
+}
+
+void
+LineStream::add(const char * text, size_t len)
+{
+    /* empty lines count too, as with dmenu */
+    if (m_count == BlockSize * MaxBlocks) {
+        return;
+    }
+
+    if (m_count % BlockSize == 0) {
+        m_blocks[m_count / BlockSize] = new Line[BlockSize];
+    }
+    auto s = m_arena.strdup(text, len);
+    m_blocks[m_count / BlockSize][m_count % BlockSize] = Line { s, Fuzzy::charMask(s) };
+    ++m_count;
+}
+
+bool
+LineStream::read()
+{
+    char buf[65536];
+    for (size_t total = 0; total < ReadBudget; ) {
+        auto n = ::read(m_fd, buf, sizeof buf);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            /* a last line without a newline still counts */
+            if (!m_partial.empty()) {
+                add(m_partial.data(), m_partial.size());
+                m_partial.clear();
+            }
+            return false;
+        }
+        total += n;
+
+        /* whole lines straight from the buffer, the rest waits for the next read */
+        const char * line { buf };
+        const char * end { buf + n };
+        while (auto nl = static_cast<const char *>(memchr(line, '\n', end - line))) {
+            if (m_partial.empty()) {
+                add(line, nl - line);
+            } else {
+                m_partial.append(line, nl - line);
+                add(m_partial.data(), m_partial.size());
+                m_partial.clear();
+            }
+            line = nl + 1;
+        }
+        m_partial.append(line, end - line);
+    }
+
+    return true;
+}
+
+size_t
+LineStream::items() const
+{
+    return m_count;
+}
+
+void
+LineStream::score(const Fuzzy& query, size_t first, size_t last, FuzzySearch::TopK& top,
+        const atomic<bool>& cancelled) const
+{
+    auto qmask = query.mask();
+    for (auto i = first; i < last && !cancelled.load(memory_order_relaxed); ++i) {
+        const auto& l = line(i);
+        if (qmask & ~l.mask) {
+            continue;
+        }
+        auto score = query.score(l.text);
+        if (score >= 0) {
+            top.add(FuzzySearch::Hit { score, static_cast<uint32_t>(i), 0 });
+        }
+    }
+}
+
+string
+LineStream::text(const FuzzySearch::Hit& hit) const
+{
+    return line(hit.item).text;
+}
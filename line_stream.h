@@ -0,0 +1,74 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef LINE_STREAM_H
+#define LINE_STREAM_H
+
+#include <cstdint>
+#include <string>
+
+#include "arena.h"
+#include "fuzzy_search.h"
+
+/*
+ * Lines read from a descriptor as they come, for the dmenu mode. The UI
+ * thread reads whenever the descriptor is readable, while searches score
+ * the lines read so far: lines are kept in blocks that never move, so that
+ * appending never disturbs a search under way.
+ */
+class LineStream : public FuzzySearch::Source {
+    public:
+        LineStream(int fd);
+        virtual ~LineStream();
+        bool read(); /* false at the end of the input */
+
+        virtual size_t items() const;
+        virtual void score(const Fuzzy& query, size_t first, size_t last, FuzzySearch::TopK& top,
+                const std::atomic<bool>& cancelled) const;
+        virtual std::string text(const FuzzySearch::Hit& hit) const;
+
+    private:
+        struct Line {
+            const char * text;
+            uint64_t mask;
+        };
+
+        void add(const char * text, size_t len);
+        const Line& line(size_t i) const { return m_blocks[i / BlockSize][i % BlockSize]; }
+
+    private:
+        /* how much to read at once, so that typing isn't held up by a fast writer */
+        static constexpr size_t ReadBudget { 1 << 20 };
+        static constexpr size_t BlockSize  { 1 << 16 };
+        static constexpr size_t MaxBlocks  { 1 << 16 };
+
+        int m_fd;
+        Arena m_arena;
+        std::string m_partial;
+        size_t m_count;
+        Line * m_blocks[MaxBlocks];
+};
+
+#endif /* !LINE_STREAM_H */
@@ -0,0 +1,89 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+using namespace std;
+
+#include "linereader.h"
+
+LineReader::LineReader(const string& fileName, Arena& arena)
+    : m_cur { nullptr },
+      m_end { nullptr }
+{
+    int fd { open(fileName.c_str(), O_RDONLY) };
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || sb.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    /* one extra byte, so the last line is always terminated */
+    auto buf = static_cast<char *>(arena.allocate(sb.st_size + 1, 1));
+    size_t len { 0 };
+    while (len < static_cast<size_t>(sb.st_size)) {
+        ssize_t n { read(fd, buf + len, sb.st_size - len) };
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    close(fd);
+
+    buf[len] = '\0';
+    m_cur = buf;
+    m_end = buf + len;
+}
+
+LineReader::~LineReader()
+{
+    // nothing to do...
+}
+
+char *
+LineReader::next()
+{
+    if (m_cur >= m_end) {
+        return nullptr;
+    }
+
+    char * line { m_cur };
+    auto nl = static_cast<char *>(memchr(m_cur, '\n', m_end - m_cur));
+    if (nl) {
+        *nl = '\0';
+        m_cur = nl + 1;
+    } else {
+        m_cur = m_end;
+    }
+
+    return line;
+}
@@ -0,0 +1,98 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cstring>
+using namespace std;
+
+#include "name_set.h"
+
+NameSet::NameSet()
+    : m_candidates { nullptr },
+      m_mask { 0 }
+{ }
+
+NameSet::~NameSet()
+{
+    // nothing to do...
+}
+
+uint64_t
+NameSet::hash(const char * s, size_t len)
+{
+    /* FNV-1a */
+    uint64_t h { 0xcbf29ce484222325ULL };
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+size_t
+NameSet::wordLength(const char * s)
+{
+    return strcspn(s, " \t");
+}
+
+void
+NameSet::build(const vector<Candidate>& candidates)
+{
+    m_candidates = &candidates;
+
+    size_t size { 2 };
+    while (size < 2 * candidates.size()) {
+        size *= 2;
+    }
+    m_slots.assign(size, 0);
+    m_mask = size - 1;
+
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        auto name = candidates[i].name;
+        auto len = wordLength(name);
+        if (len == 0 || contains(name, len)) {
+            continue;
+        }
+        auto slot = hash(name, len) & m_mask;
+        while (m_slots[slot]) {
+            slot = (slot + 1) & m_mask;
+        }
+        m_slots[slot] = i + 1;
+    }
+}
+
+bool
+NameSet::contains(const char * word, size_t len) const
+{
+    if (m_candidates == nullptr) {
+        return false;
+    }
+
+    for (auto slot = hash(word, len) & m_mask; m_slots[slot]; slot = (slot + 1) & m_mask) {
+        auto name = (*m_candidates)[m_slots[slot] - 1].name;
+        if (strncmp(name, word, len) == 0 && (name[len] == '\0' || name[len] == ' ' || name[len] == '\t')) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef NAME_SET_H
+#define NAME_SET_H
+
+#include <cstdint>
+#include <vector>
+
+#include "provider.h"
+
+/*
+ * The set of the first words of a run of candidates, e.g. the commands of
+ * bookmarked command lines, as an open-addressing hash table of candidate
+ * positions at most half full. A lookup hashes the word and compares it
+ * with one or two names, so that what's typed can be checked on every key.
+ */
+class NameSet {
+    public:
+        NameSet();
+        NameSet(const NameSet&) = delete;
+        NameSet& operator=(const NameSet&) = delete;
+        ~NameSet();
+
+        void build(const std::vector<Candidate>& candidates);
+        bool contains(const char * word, size_t len) const;
+
+    private:
+        static uint64_t hash(const char * s, size_t len);
+        static size_t wordLength(const char * s);
+
+    private:
+        const std::vector<Candidate> * m_candidates;
+        std::vector<uint32_t> m_slots; /* 1 + the position of a candidate, 0 if empty */
+        size_t m_mask;
+};
+
+#endif /* !NAME_SET_H */
@@ -0,0 +1,181 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include "pick_memory.h"
+#include "search_key.h"
+#include "util.h"
+
+namespace {
+    constexpr double HalfLife   { 14 * 24 * 3600 }; /* s */
+    constexpr float  Forgotten  { 0.05f };          /* weight below which a pick is dropped */
+    constexpr size_t MaxPicks   { 4 };              /* per prefix */
+    constexpr size_t MaxPrefix  { 32 };             /* bytes of a query remembered */
+}
+
+PickMemory::PickMemory()
+{
+    m_key.reserve(MaxPrefix);
+
+    FILE * in { fopen(memoryFile().c_str(), "r") };
+    if (in == nullptr) {
+        return;
+    }
+
+    /* prefix, name, weight and stamp, tab-separated and escaped */
+    char line[1024];
+    while (fgets(line, sizeof line, in)) {
+        line[strcspn(line, "\n")] = '\0';
+        char * fields[4];
+        size_t n { 0 };
+        for (char * p = line; n < 4 && p; ++n) {
+            fields[n] = p;
+            p = strchr(p, '\t');
+            if (p) {
+                *p++ = '\0';
+            }
+        }
+        if (n == 4 && *fields[0] && *fields[1]) {
+            auto& picks = m_picks[Util::unescape(fields[0])];
+            if (picks.size() < MaxPicks) {
+                picks.push_back(Pick { Util::unescape(fields[1]), strtof(fields[2], nullptr),
+                                       static_cast<time_t>(strtoll(fields[3], nullptr, 10)) });
+            }
+        }
+    }
+    fclose(in);
+}
+
+PickMemory::~PickMemory()
+{
+    // nothing to do...
+}
+
+string
+PickMemory::memoryFile()
+{
+    return Util::getEnv("HOME") + "/.thingylaunch.picks";
+}
+
+float
+PickMemory::decayed(const Pick& p, time_t now)
+{
+    return p.weight * exp2(-difftime(now, p.stamp) / HalfLife);
+}
+
+const char *
+PickMemory::lookup(const char * key) const
+{
+    /* no longer key is remembered, and a short one is copied without allocating */
+    auto len = strlen(key);
+    if (len > MaxPrefix) {
+        return nullptr;
+    }
+    m_key.assign(key, len);
+
+    auto iter = m_picks.find(m_key);
+    if (iter == end(m_picks)) {
+        return nullptr;
+    }
+
+    auto now = time(nullptr);
+    auto best = max_element(begin(iter->second), end(iter->second), [now] (const Pick& a, const Pick& b) {
+        return decayed(a, now) < decayed(b, now);
+    });
+    return best->name.c_str();
+}
+
+void
+PickMemory::record(const string& query, const char * picked)
+{
+    /* the name may be one of ours */
+    string name { picked };
+    string buf;
+    string key { SearchKey::folded(query.c_str(), buf) };
+    auto cut = min(key.size(), MaxPrefix);
+    while (cut > 0 && cut < key.size() && (static_cast<unsigned char>(key[cut]) & 0xc0) == 0x80) {
+        --cut;
+    }
+    key.resize(cut);
+
+    /* every prefix of the query, cut on character boundaries */
+    auto now = time(nullptr);
+    for (size_t len = key.size(); len > 0; --len) {
+        if ((static_cast<unsigned char>(key[len]) & 0xc0) == 0x80) {
+            continue;
+        }
+        auto& picks = m_picks[key.substr(0, len)];
+        auto iter = find_if(begin(picks), end(picks), [name] (const Pick& p) { return p.name == name; });
+        if (iter == end(picks)) {
+            if (picks.size() == MaxPicks) {
+                /* make room by forgetting the least picked */
+                picks.erase(min_element(begin(picks), end(picks), [now] (const Pick& a, const Pick& b) {
+                    return decayed(a, now) < decayed(b, now);
+                }));
+            }
+            picks.push_back(Pick { name, 0, now });
+            iter = end(picks) - 1;
+        }
+        iter->weight = decayed(*iter, now) + 1;
+        iter->stamp = now;
+    }
+
+    save();
+}
+
+void
+PickMemory::save() const
+{
+    /* each launcher saves after a pick, and a launcher starting meanwhile loads one whole set */
+    string fileName { memoryFile() };
+    string tmpFile;
+    FILE * out { Util::createTemp(fileName, tmpFile) };
+    if (out == nullptr) {
+        return;
+    }
+
+    /* names from the history may hold tabs */
+    auto now = time(nullptr);
+    string keyBuf;
+    string nameBuf;
+    for (const auto& entry : m_picks) {
+        auto key = Util::escape(entry.first.c_str(), keyBuf);
+        for (const auto& p : entry.second) {
+            if (decayed(p, now) >= Forgotten) {
+                fprintf(out, "%s\t%s\t%g\t%lld\n", key, Util::escape(p.name.c_str(), nameBuf), p.weight,
+                        static_cast<long long>(p.stamp));
+            }
+        }
+    }
+    if (fclose(out) != 0 || rename(tmpFile.c_str(), fileName.c_str()) != 0) {
+        remove(tmpFile.c_str());
+    }
+}
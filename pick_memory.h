@@ -0,0 +1,68 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PICK_MEMORY_H
+#define PICK_MEMORY_H
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * What was picked after typing what, kept in ~/.thingylaunch.picks: each
+ * folded prefix of a query that Tab completed maps to the few names picked
+ * for it, weighted by how often and decaying with a half-life of two weeks.
+ * A lookup is a hash of the typed prefix, so the remembered pick can be
+ * offered before any index is searched, or even built.
+ */
+class PickMemory {
+    public:
+        PickMemory();
+        ~PickMemory();
+
+        /* the name most picked for the folded key, or nullptr */
+        const char * lookup(const char * key) const;
+        /* picked after typing query; invalidates what lookup returned */
+        void record(const std::string& query, const char * picked);
+
+        static std::string memoryFile();
+
+    private:
+        struct Pick {
+            std::string name;
+            float weight;
+            time_t stamp;
+        };
+
+        static float decayed(const Pick& p, time_t now);
+        void save() const;
+
+    private:
+        std::unordered_map<std::string, std::vector<Pick>> m_picks;
+        mutable std::string m_key; /* what lookup searches for */
+};
+
+#endif /* !PICK_MEMORY_H */
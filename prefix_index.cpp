@@ -0,0 +1,121 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+#include "prefix_index.h"
+
+namespace {
+    constexpr size_t CacheLine   { 64 };
+    constexpr size_t KeysPerLine { CacheLine / sizeof(uint64_t) };
+
+    /* lay the keys out in Eytzinger order, returning the next key in sorted order */
+    size_t
+    fill(const vector<Candidate>& sorted, size_t next, size_t k, uint64_t * keys, uint32_t * rank)
+    {
+        if (k < sorted.size() + 1) {
+            next = fill(sorted, next, 2 * k, keys, rank);
+            keys[k] = PrefixIndex::key(sorted[next].name);
+            rank[k] = next++;
+            next = fill(sorted, next, 2 * k + 1, keys, rank);
+        }
+        return next;
+    }
+}
+
+PrefixIndex::PrefixIndex()
+    : m_keys { nullptr },
+      m_size { 0 }
+{ }
+
+PrefixIndex::~PrefixIndex()
+{
+    // nothing to do...
+}
+
+uint64_t
+PrefixIndex::key(const char * s)
+{
+    /* shorter names are padded with zeroes, so that they sort first */
+    uint64_t k { 0 };
+    size_t i { 0 };
+    for (; i < sizeof k && s[i]; ++i) {
+        k = k << 8 | static_cast<unsigned char>(s[i]);
+    }
+    return i == sizeof k ? k : k << (8 * (sizeof k - i));
+}
+
+void
+PrefixIndex::build(const vector<Candidate>& sorted)
+{
+    m_size = sorted.size();
+
+    /* key k's descendants three levels down, 8k to 8k+7, fill exactly one cache line */
+    m_storage.assign(m_size + 1 + KeysPerLine, 0);
+    auto addr = reinterpret_cast<uintptr_t>(m_storage.data());
+    auto keys = reinterpret_cast<uint64_t *>((addr + CacheLine - 1) & ~(CacheLine - 1));
+    m_keys = keys;
+
+    m_rank.assign(m_size + 1, 0);
+    fill(sorted, 0, 1, keys, m_rank.data());
+}
+
+size_t
+PrefixIndex::lowerBound(uint64_t key) const
+{
+    size_t k { 1 };
+    while (k <= m_size) {
+        /* the prefetch address may be past the end, which doesn't fault */
+        __builtin_prefetch(reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(m_keys) +
+                    k * KeysPerLine * sizeof(uint64_t)));
+        k = 2 * k + (m_keys[k] < key);
+    }
+
+    /* undo the right turns taken after the last left one, which found the bound */
+    k >>= __builtin_ffsll(~k);
+    return k ? m_rank[k] : m_size;
+}
+
+pair<size_t, size_t>
+PrefixIndex::range(const vector<Candidate>& sorted, const char * prefix, size_t len) const
+{
+    auto low = key(prefix);
+    if (len < sizeof low) {
+        /* the names starting with a short prefix are exactly those between two keys */
+        auto high = low | (~0ULL >> (8 * len));
+        return { lowerBound(low), high == ~0ULL ? m_size : lowerBound(high + 1) };
+    }
+
+    /* the names sharing the prefix's key, narrowed down on the names */
+    auto first = begin(sorted) + lowerBound(low);
+    auto last = begin(sorted) + (low == ~0ULL ? m_size : lowerBound(low + 1));
+    first = lower_bound(first, last, prefix,
+            [] (const Candidate& c, const char * p) { return strcmp(c.name, p) < 0; });
+    last = partition_point(first, last,
+            [prefix, len] (const Candidate& c) { return strncmp(c.name, prefix, len) == 0; });
+    return { first - begin(sorted), last - begin(sorted) };
+}
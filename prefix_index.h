@@ -0,0 +1,67 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PREFIX_INDEX_H
+#define PREFIX_INDEX_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "provider.h"
+
+/*
+ * A search structure over a set of candidates sorted by name. The first 8
+ * bytes of each name are packed into a big-endian integer, so that integer
+ * order is name order, and the keys are laid out in Eytzinger (breadth-first)
+ * order: a search walks down from the root touching one key per level, the
+ * keys of the levels to come share cache lines and are prefetched ahead,
+ * and there is no branch to mispredict. Names themselves are only looked at
+ * for prefixes longer than a key.
+ */
+class PrefixIndex {
+    public:
+        PrefixIndex();
+        PrefixIndex(const PrefixIndex&) = delete;
+        PrefixIndex& operator=(const PrefixIndex&) = delete;
+        ~PrefixIndex();
+
+        void build(const std::vector<Candidate>& sorted);
+        /* the [first, last) candidates whose name starts with the prefix */
+        std::pair<size_t, size_t> range(const std::vector<Candidate>& sorted, const char * prefix, size_t len) const;
+
+        static uint64_t key(const char * s);
+
+    private:
+        size_t lowerBound(uint64_t key) const;
+
+    private:
+        std::vector<uint64_t> m_storage;
+        const uint64_t * m_keys; /* 1-based, in m_storage and aligned on a cache line */
+        std::vector<uint32_t> m_rank; /* the position of each key in sorted order */
+        size_t m_size;
+};
+
+#endif /* !PREFIX_INDEX_H */
@@ -0,0 +1,71 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PROVIDER_H
+#define PROVIDER_H
+
+#include <cstdint>
+#include <vector>
+
+class ResultQueue;
+
+/* A completion candidate; higher scores are offered first */
+struct Candidate {
+    const char * name;
+    uint32_t score;
+};
+
+/*
+ * A source of completion candidates. Providers run on a worker thread and
+ * stream their candidates in batches; the strings they hand out must stay
+ * valid for as long as the provider exists.
+ */
+struct Provider {
+    virtual ~Provider() { }
+    /* a short name, for instrumentation */
+    virtual const char * name() const =0;
+    /* produce candidates, on a worker thread */
+    virtual void run(ResultQueue& queue) =0;
+    /* called on the UI thread, once all candidates have been indexed */
+    virtual void finished() { }
+    /* whether the first word of each candidate is a command that can be run */
+    virtual bool commands() const { return false; }
+};
+
+/* A set of candidates, as delivered from a provider to the index */
+struct Batch {
+    enum Kind {
+        Begin, /* a provider starts, replacing any earlier one of the same name */
+        Data,
+        End
+    };
+
+    Provider * provider;
+    Kind kind;
+    std::vector<Candidate> candidates;
+    Batch * next;
+};
+
+#endif /* !PROVIDER_H */
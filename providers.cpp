@@ -0,0 +1,275 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+using namespace std;
+
+#include "bookmark.h"
+#include "history.h"
+#include "providers.h"
+#include "result_queue.h"
+#include "snapshot.h"
+#include "system_index.h"
+#include "util.h"
+
+namespace {
+    /* offer bookmarks first, then past commands, then executables */
+    constexpr uint32_t ExecutableScore { 0 };
+    constexpr uint32_t HistoryScore    { 1000 };
+    constexpr uint32_t BookmarkScore   { 100000 };
+    constexpr uint32_t WindowScore     { 0 };
+}
+
+ExecutableProvider::ExecutableProvider(Snapshot& snap)
+    : m_snap { snap },
+      m_cached { false },
+      m_names { ArenaAllocator<const char *> { m_arena } }
+{
+    /* get PATH env */
+    string path { Util::getEnv("PATH") };
+
+    /* tokenize path */
+    string::size_type pos { 0 };
+    for (;;) {
+        auto colon = path.find(':', pos);
+        m_pathElements.push_back(path.substr(pos, colon - pos));
+        if (colon == string::npos) {
+            break;
+        }
+        pos = colon + 1;
+    }
+
+    m_pathStamp = pathStamp();
+
+    /* only directories the system index doesn't know about are ours to cache */
+    for (const auto& pathElem : m_pathElements) {
+        (m_sysIndex.covers(pathElem) ? m_sharedDirs : m_privateDirs).push_back(pathElem);
+    }
+
+    /* the result depends on who we are and on the contents of each directory */
+    uint64_t ids[] { getuid(), getgid() };
+    m_fingerprint = Snapshot::hash(ids, sizeof ids);
+    for (const auto& dir : m_privateDirs) {
+        m_fingerprint = Snapshot::stamp(dir, m_fingerprint);
+    }
+
+    /* the snapshot is only ever touched on the UI thread */
+    m_cached = m_snap.lookup(Snapshot::Sec_Completion, m_fingerprint, m_names);
+}
+
+ExecutableProvider::~ExecutableProvider()
+{
+    // nothing to do...
+}
+
+uint64_t
+ExecutableProvider::pathStamp() const
+{
+    uint64_t stamp { Snapshot::hash(nullptr, 0) };
+    for (const auto& pathElem : m_pathElements) {
+        stamp = Snapshot::stamp(pathElem, stamp);
+    }
+    return stamp;
+}
+
+bool
+ExecutableProvider::stale() const
+{
+    return pathStamp() != m_pathStamp || m_sysIndex.stale();
+}
+
+void
+ExecutableProvider::run(ResultQueue& queue)
+{
+    uid_t uid { getuid() };
+    gid_t gid { getgid() };
+
+    /* the shared directories point straight into the system index */
+    if (!m_sharedDirs.empty()) {
+        vector<const char *> names;
+        for (const auto& dir : m_sharedDirs) {
+            m_sysIndex.lookup(dir, uid, gid, names);
+        }
+        auto batch = new Batch { this, Batch::Data, { }, nullptr };
+        batch->candidates.reserve(names.size());
+        for (auto name : names) {
+            batch->candidates.push_back(Candidate { name, ExecutableScore });
+        }
+        queue.push(batch);
+    }
+
+    if (m_cached) {
+        auto batch = new Batch { this, Batch::Data, { }, nullptr };
+        batch->candidates.reserve(m_names.size());
+        for (auto name : m_names) {
+            batch->candidates.push_back(Candidate { name, ExecutableScore });
+        }
+        queue.push(batch);
+        return;
+    }
+
+    struct stat sb;
+    string currentPath;
+
+    for (const auto& pathElem : m_privateDirs) {
+
+        if (queue.stopping()) {
+            return;
+        }
+
+        /* open the directory pointed to by path */
+        DIR * dirp { opendir(pathElem.c_str()) };
+        if (dirp == nullptr) {
+            continue;
+        }
+
+        /* traverse directory */
+        auto first = m_names.size();
+        struct dirent * dp;
+        while ((dp = readdir(dirp))) {
+
+            currentPath.assign(pathElem).append(1, '/').append(dp->d_name);
+            /* create a 'path/file' string and check whether we can access meta-information */
+            if (stat(currentPath.c_str(), &sb) == -1) {
+                continue;
+            }
+
+            /* a regular, executable file*/
+            if (Util::isExecutable(sb.st_mode, sb.st_uid, sb.st_gid, uid, gid)) {
+                m_names.push_back(m_arena.strdup(dp->d_name, strlen(dp->d_name)));
+            }
+        }
+        closedir(dirp);
+
+        /* stream each directory as soon as it's been read */
+        auto batch = new Batch { this, Batch::Data, { }, nullptr };
+        batch->candidates.reserve(m_names.size() - first);
+        for (auto i = first; i < m_names.size(); ++i) {
+            batch->candidates.push_back(Candidate { m_names[i], ExecutableScore });
+        }
+        queue.push(batch);
+    }
+
+    sort(begin(m_names), end(m_names), [] (const char * a, const char * b) { return strcmp(a, b) < 0; });
+}
+
+void
+ExecutableProvider::finished()
+{
+    if (!m_cached) {
+        m_snap.update(Snapshot::Sec_Completion, m_fingerprint, m_names);
+        m_snap.save();
+        m_cached = true;
+    }
+}
+
+HistoryProvider::HistoryProvider(const History& hist)
+    : m_lines(begin(hist.elements()), end(hist.elements()))
+{ }
+
+HistoryProvider::~HistoryProvider()
+{
+    // nothing to do...
+}
+
+void
+HistoryProvider::run(ResultQueue& queue)
+{
+    sort(begin(m_lines), end(m_lines), [] (const char * a, const char * b) { return strcmp(a, b) < 0; });
+
+    /* one candidate per distinct command, scored by how often it was run */
+    auto batch = new Batch { this, Batch::Data, { }, nullptr };
+    for (auto i = begin(m_lines); i != end(m_lines); ) {
+        auto j = i + 1;
+        while (j != end(m_lines) && strcmp(*i, *j) == 0) {
+            ++j;
+        }
+        batch->candidates.push_back(Candidate { *i, HistoryScore + static_cast<uint32_t>(j - i) });
+        i = j;
+    }
+    queue.push(batch);
+}
+
+BookmarkProvider::BookmarkProvider(const Bookmark& book)
+{
+    /* bookmarks can be reloaded under our feet, so keep our own copies */
+    book.commands(m_commands);
+    for (auto& c : m_commands) {
+        c = m_arena.strdup(c, strlen(c));
+    }
+}
+
+BookmarkProvider::~BookmarkProvider()
+{
+    // nothing to do...
+}
+
+void
+BookmarkProvider::run(ResultQueue& queue)
+{
+    auto batch = new Batch { this, Batch::Data, { }, nullptr };
+    for (auto c : m_commands) {
+        batch->candidates.push_back(Candidate { c, BookmarkScore });
+    }
+    queue.push(batch);
+}
+
+WindowProvider::WindowProvider(const vector<X11Window>& windows)
+{
+    for (const auto& w : windows) {
+        auto l = label(w);
+        m_labels.push_back(m_arena.strdup(l.c_str(), l.size()));
+    }
+}
+
+WindowProvider::~WindowProvider()
+{
+    // nothing to do...
+}
+
+string
+WindowProvider::label(const X11Window& window)
+{
+    return window.wmClass + ": " + window.name;
+}
+
+void
+WindowProvider::run(ResultQueue& queue)
+{
+    /* later clients in _NET_CLIENT_LIST were mapped more recently, offer them first */
+    auto batch = new Batch { this, Batch::Data, { }, nullptr };
+    uint32_t score { WindowScore };
+    for (auto l : m_labels) {
+        batch->candidates.push_back(Candidate { l, score++ });
+    }
+    queue.push(batch);
+}
@@ -0,0 +1,113 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PROVIDERS_H
+#define PROVIDERS_H
+
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "provider.h"
+#include "system_index.h"
+#include "x11_interface.h"
+
+class Bookmark;
+class History;
+class Snapshot;
+
+/*
+ * Executables found in PATH. Directories covered by the system index are
+ * read from it, the others are cached in the snapshot. The index is mapped
+ * for as long as the provider lives, since its candidates point into it.
+ */
+class ExecutableProvider : public Provider {
+    public:
+        ExecutableProvider(Snapshot& snap);
+        virtual ~ExecutableProvider();
+        virtual const char * name() const { return "executables"; }
+        virtual void run(ResultQueue& queue);
+        virtual void finished();
+        virtual bool commands() const { return true; }
+        bool stale() const; /* PATH directories or the system index changed since */
+
+    private:
+        uint64_t pathStamp() const;
+
+    private:
+        Snapshot& m_snap;
+        SystemIndex m_sysIndex;
+        Arena m_arena;
+        std::vector<std::string> m_pathElements;
+        std::vector<std::string> m_sharedDirs;
+        std::vector<std::string> m_privateDirs;
+        uint64_t m_pathStamp;
+        uint64_t m_fingerprint;
+        bool m_cached;
+        ArenaVector<const char *> m_names;
+};
+
+/* Past commands, ranked by how often they were run */
+class HistoryProvider : public Provider {
+    public:
+        HistoryProvider(const History& hist);
+        virtual ~HistoryProvider();
+        virtual const char * name() const { return "history"; }
+        virtual void run(ResultQueue& queue);
+
+    private:
+        std::vector<const char *> m_lines;
+};
+
+/* The commands of all bookmarks */
+class BookmarkProvider : public Provider {
+    public:
+        BookmarkProvider(const Bookmark& book);
+        virtual ~BookmarkProvider();
+        virtual const char * name() const { return "bookmarks"; }
+        virtual void run(ResultQueue& queue);
+        virtual bool commands() const { return true; }
+
+    private:
+        Arena m_arena;
+        std::vector<const char *> m_commands;
+};
+
+/* Client windows, labelled "class: name" */
+class WindowProvider : public Provider {
+    public:
+        WindowProvider(const std::vector<X11Window>& windows);
+        virtual ~WindowProvider();
+        virtual const char * name() const { return "windows"; }
+        virtual void run(ResultQueue& queue);
+
+        static std::string label(const X11Window& window);
+
+    private:
+        Arena m_arena;
+        std::vector<const char *> m_labels;
+};
+
+#endif /* !PROVIDERS_H */
@@ -0,0 +1,300 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+using namespace std;
+
+#include "ranker.h"
+#include "search_key.h"
+#include "util.h"
+
+namespace {
+    /* four floats, a SIMD register wide on any target worth running on */
+    typedef float Lanes __attribute__((vector_size(16)));
+    constexpr size_t LaneCount    { sizeof(Lanes) / sizeof(float) };
+
+    /* logistic regression, by full-batch gradient descent with L2 regularization */
+    constexpr int    Iterations   { 1000 };
+    constexpr double LearningRate { 0.5 };
+    constexpr double Decay        { 1e-3 };
+
+    /* the log is cut down to its newest half past this size */
+    constexpr long   MaxLogSize   { 1 << 20 }; /* bytes */
+
+    size_t
+    padded(size_t n)
+    {
+        return (n + LaneCount - 1) / LaneCount * LaneCount;
+    }
+
+    /* keep the queries logged in the last keep bytes of the file, whole */
+    void
+    trimLog(const string& fileName, long keep)
+    {
+        FILE * in { fopen(fileName.c_str(), "r") };
+        if (in == nullptr) {
+            return;
+        }
+        string log;
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof buf, in)) > 0) {
+            log.append(buf, n);
+        }
+        fclose(in);
+
+        auto from = log.size() > static_cast<size_t>(keep) ? log.size() - keep : 0;
+        from = log.find("\n? ", from);
+        from = from == string::npos ? log.size() : from + 1;
+
+        string tmpFile;
+        FILE * out { Util::createTemp(fileName, tmpFile) };
+        if (out == nullptr) {
+            return;
+        }
+        fwrite(log.data() + from, 1, log.size() - from, out);
+        if (fclose(out) != 0 || rename(tmpFile.c_str(), fileName.c_str()) != 0) {
+            remove(tmpFile.c_str());
+        }
+    }
+}
+
+Ranker::Ranker()
+    : m_enabled { false },
+      m_weights { }
+{
+    FILE * in { fopen(modelFile().c_str(), "r") };
+    if (in == nullptr) {
+        return;
+    }
+    size_t n { 0 };
+    while (n < Features && fscanf(in, "%f", &m_weights[n]) == 1) {
+        ++n;
+    }
+    fclose(in);
+    m_enabled = n == Features;
+}
+
+Ranker::~Ranker()
+{
+    // nothing to do...
+}
+
+string
+Ranker::logFile()
+{
+    return Util::getEnv("HOME") + "/.thingylaunch.ranking";
+}
+
+string
+Ranker::modelFile()
+{
+    return Util::getEnv("HOME") + "/.thingylaunch.model";
+}
+
+void
+Ranker::reserve(size_t size)
+{
+    if (!m_enabled) {
+        return;
+    }
+    for (auto& f : m_features) {
+        f.reserve(padded(size));
+    }
+    m_scores.reserve(padded(size));
+    m_order.reserve(size);
+    m_ranked.reserve(size);
+}
+
+void
+Ranker::features(const Candidate& c, const string& query, bool abbrev, float * out)
+{
+    auto word = strcspn(c.name, " \t");
+    auto prefix = strncmp(c.name, query.c_str(), query.size()) == 0;
+
+    out[Feat_Bias] = 1;
+    out[Feat_Score] = log1p(c.score) / 12;
+    out[Feat_CasePrefix] = prefix;
+    out[Feat_Abbrev] = abbrev;
+    out[Feat_Exact] = prefix && word == query.size();
+    out[Feat_Coverage] = word ? min(1.0f, static_cast<float>(query.size()) / word) : 1.0f;
+    out[Feat_Length] = log1p(strlen(c.name)) / 4;
+    out[Feat_Args] = c.name[word] != '\0';
+}
+
+void
+Ranker::rank(vector<Candidate>& matches, size_t first, size_t prefixed, const string& query)
+{
+    auto n = matches.size() - first;
+    if (!m_enabled || n < 2) {
+        return;
+    }
+
+    /* one array per feature, padded with zeroes to a whole number of lanes */
+    for (auto& f : m_features) {
+        f.assign(padded(n), 0);
+    }
+    float f[Features];
+    for (size_t i = 0; i < n; ++i) {
+        features(matches[first + i], query, first + i >= prefixed, f);
+        for (size_t k = 0; k < Features; ++k) {
+            m_features[k][i] = f[k];
+        }
+    }
+
+    m_scores.resize(padded(n));
+    for (size_t i = 0; i < n; i += LaneCount) {
+        Lanes acc { };
+        for (size_t k = 0; k < Features; ++k) {
+            Lanes lanes;
+            memcpy(&lanes, &m_features[k][i], sizeof lanes);
+            acc += m_weights[k] * lanes;
+        }
+        memcpy(&m_scores[i], &acc, sizeof acc);
+    }
+
+    /* best first, in the providers' order among equals */
+    m_order.resize(n);
+    iota(begin(m_order), end(m_order), 0);
+    sort(begin(m_order), end(m_order), [this] (uint32_t a, uint32_t b) {
+        return m_scores[a] != m_scores[b] ? m_scores[a] > m_scores[b] : a < b;
+    });
+    m_ranked.clear();
+    for (auto i : m_order) {
+        m_ranked.push_back(matches[first + i]);
+    }
+    copy(begin(m_ranked), end(m_ranked), begin(matches) + first);
+}
+
+void
+Ranker::record(const string& query, const vector<Candidate>& matches, size_t shown)
+{
+    string fileName { logFile() };
+    FILE * out { fopen(fileName.c_str(), "a") };
+    if (out == nullptr) {
+        return;
+    }
+
+    /* what was seen rather than its features, which training derives; a pasted query may span lines */
+    string buf;
+    fprintf(out, "? %s\n", Util::escape(query.c_str(), buf));
+    for (size_t i = 0; i < shown; ++i) {
+        fprintf(out, "%c %u %s\n", i == shown - 1 ? '+' : '-', matches[i].score, Util::escape(matches[i].name, buf));
+    }
+    auto size = ftell(out);
+    fclose(out);
+
+    if (size > MaxLogSize) {
+        trimLog(fileName, MaxLogSize / 2);
+    }
+}
+
+bool
+Ranker::train(const string& logFile, const string& modelFile)
+{
+    FILE * in { fopen(logFile.c_str(), "r") };
+    if (in == nullptr) {
+        return false;
+    }
+
+    /* a query, then the matches shown for it, each with its score and whether it was picked */
+    vector<float> x;
+    vector<float> y;
+    string query;
+    string queryBuf;
+    string nameBuf;
+    const char * key { "" };
+    char line[1024];
+    while (fgets(line, sizeof line, in)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '?' && line[1] == ' ') {
+            query = Util::unescape(line + 2);
+            key = SearchKey::folded(query.c_str(), queryBuf);
+            continue;
+        }
+
+        if ((line[0] != '+' && line[0] != '-') || query.empty()) {
+            continue;
+        }
+        char * e;
+        auto score = strtoul(line + 1, &e, 10);
+        if (e == line + 1 || *e != ' ') {
+            continue;
+        }
+        Candidate c { Util::unescape(e + 1), static_cast<uint32_t>(score) };
+        auto name = SearchKey::folded(c.name, nameBuf);
+
+        float f[Features];
+        features(c, query, strncmp(name, key, strlen(key)) != 0, f);
+        y.push_back(line[0] == '+');
+        x.insert(end(x), f, f + Features);
+    }
+    fclose(in);
+
+    if (y.empty()) {
+        errno = ENODATA;
+        return false;
+    }
+
+    double w[Features] { };
+    for (int it = 0; it < Iterations; ++it) {
+        double g[Features] { };
+        for (size_t i = 0; i < y.size(); ++i) {
+            const float * f { &x[i * Features] };
+            double z { 0 };
+            for (size_t k = 0; k < Features; ++k) {
+                z += w[k] * f[k];
+            }
+            double d { 1 / (1 + exp(-z)) - y[i] };
+            for (size_t k = 0; k < Features; ++k) {
+                g[k] += d * f[k];
+            }
+        }
+        for (size_t k = 0; k < Features; ++k) {
+            w[k] -= LearningRate * (g[k] / y.size() + Decay * w[k]);
+        }
+    }
+
+    /* a launcher starting during training loads the old weights or the new ones */
+    string tmpFile;
+    FILE * out { Util::createTemp(modelFile, tmpFile) };
+    if (out == nullptr) {
+        return false;
+    }
+    for (size_t k = 0; k < Features; ++k) {
+        fprintf(out, "%g%c", w[k], k + 1 < Features ? ' ' : '\n');
+    }
+    bool ok { fclose(out) == 0 && rename(tmpFile.c_str(), modelFile.c_str()) == 0 };
+    if (!ok) {
+        remove(tmpFile.c_str());
+    }
+    return ok;
+}
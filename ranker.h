@@ -0,0 +1,86 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef RANKER_H
+#define RANKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "provider.h"
+
+/*
+ * Completion matches ranked by a linear model over a few features of each
+ * match, fitted with -train-ranking from a log of what was offered on Tab
+ * and what was picked. Without a model, the providers' scores rank alone.
+ * Features are kept one array per feature, so that the model scores four
+ * matches at a time.
+ */
+class Ranker {
+    public:
+        enum Feature {
+            Feat_Bias,
+            Feat_Score,      /* the provider's, on a log scale */
+            Feat_CasePrefix, /* the query starts the name as typed */
+            Feat_Abbrev,     /* the query abbreviates the name */
+            Feat_Exact,      /* the query is the whole command */
+            Feat_Coverage,   /* how much of the command the query is */
+            Feat_Length,     /* of the name, on a log scale */
+            Feat_Args,       /* the name is a command line */
+            Features
+        };
+
+        Ranker(); /* with the user's model, if any */
+        ~Ranker();
+
+        bool enabled() const { return m_enabled; }
+        void reserve(size_t size);
+        /*
+         * Reorder the matches from first on by the model, stable among equal
+         * scores; those before prefixed start with the query once folded, the
+         * rest abbreviate it.
+         */
+        void rank(std::vector<Candidate>& matches, size_t first, size_t prefixed, const std::string& query);
+        /* log the query and the first shown matches, the last one being picked */
+        void record(const std::string& query, const std::vector<Candidate>& matches, size_t shown);
+
+        static std::string logFile();
+        static std::string modelFile();
+        static bool train(const std::string& logFile, const std::string& modelFile);
+
+    private:
+        static void features(const Candidate& c, const std::string& query, bool abbrev, float * out);
+
+    private:
+        bool m_enabled;
+        float m_weights[Features];
+        std::vector<float> m_features[Features];
+        std::vector<float> m_scores;
+        std::vector<uint32_t> m_order;
+        std::vector<Candidate> m_ranked;
+};
+
+#endif /* !RANKER_H */
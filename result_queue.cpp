@@ -0,0 +1,91 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+using namespace std;
+
+#include "result_queue.h"
+
+ResultQueue::ResultQueue(function<void()> ready)
+    : m_head { nullptr },
+      m_stop { false },
+      m_ready { move(ready) }
+{ }
+
+ResultQueue::~ResultQueue()
+{
+    for (auto b = m_head.exchange(nullptr); b; ) {
+        auto next = b->next;
+        delete b;
+        b = next;
+    }
+}
+
+void
+ResultQueue::push(Batch * batch)
+{
+    batch->next = m_head.load(memory_order_relaxed);
+    while (!m_head.compare_exchange_weak(batch->next, batch, memory_order_release, memory_order_relaxed))
+        ;
+
+    /* only the first batch of a run needs to notify the consumer */
+    if (batch->next == nullptr) {
+        m_ready();
+    }
+}
+
+Batch *
+ResultQueue::takeAll()
+{
+    auto b = m_head.exchange(nullptr, memory_order_acquire);
+
+    /* the list is newest first, hand it out in delivery order */
+    Batch * ordered { nullptr };
+    while (b) {
+        auto next = b->next;
+        b->next = ordered;
+        ordered = b;
+        b = next;
+    }
+
+    return ordered;
+}
+
+bool
+ResultQueue::pending() const
+{
+    return m_head.load(memory_order_relaxed) != nullptr;
+}
+
+void
+ResultQueue::stop()
+{
+    m_stop.store(true, memory_order_relaxed);
+}
+
+bool
+ResultQueue::stopping() const
+{
+    return m_stop.load(memory_order_relaxed);
+}
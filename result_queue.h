@@ -0,0 +1,56 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef RESULT_QUEUE_H
+#define RESULT_QUEUE_H
+
+#include <atomic>
+#include <functional>
+
+#include "provider.h"
+
+/*
+ * A lock-free multi-producer, single-consumer queue of batches. Producers
+ * push onto an atomic list; the consumer takes the whole list at once, and
+ * is notified through the ready callback whenever the list turns non-empty.
+ */
+class ResultQueue {
+    public:
+        ResultQueue(std::function<void()> ready);
+        ~ResultQueue();
+        void push(Batch * batch);
+        Batch * takeAll();
+        bool pending() const;
+
+        void stop();
+        bool stopping() const;
+
+    private:
+        std::atomic<Batch *> m_head;
+        std::atomic<bool> m_stop;
+        std::function<void()> m_ready;
+};
+
+#endif /* !RESULT_QUEUE_H */
@@ -0,0 +1,168 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+#include "search_key.h"
+
+namespace {
+    constexpr char     Keep   { '-' };
+
+    /* the base letters of U+00C0 to U+00FF and of U+0100 to U+017F */
+    constexpr char     Latin1[] { "aaaaaa-ceeeeiiiidnooooo-ouuuuy--"
+                                  "aaaaaa-ceeeeiiiidnooooo-ouuuuy-y" };
+    constexpr char     LatinExtA[] { "aaaaaaccccccccddddeeeeeeeeeegggggggghhhh"
+                                     "iiiiiiiiii--jjkk-llllllllllnnnnnn---oooooo"
+                                     "--rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzz"
+                                     "zzzs" };
+    static_assert(sizeof Latin1 == 64 + 1, "one letter per code point");
+    static_assert(sizeof LatinExtA == 128 + 1, "one letter per code point");
+
+    constexpr uint64_t Ones   { 0x0101010101010101ULL };
+    constexpr uint64_t High   { 0x8080808080808080ULL };
+
+    /* the high bit of each byte of w in 'A' to 'Z', for bytes below 0x80 */
+    inline uint64_t
+    upper(uint64_t w)
+    {
+        return (w + Ones * (0x80 - 'A')) & ~(w + Ones * (0x80 - 'Z' - 1)) & High;
+    }
+
+    bool
+    isSeparator(unsigned char c)
+    {
+        return c == '-' || c == '_' || c == '.';
+    }
+
+    void
+    fold(unsigned cp, string& buf)
+    {
+        if (cp >= 0x300 && cp < 0x370) {
+            /* combining diacritical marks */
+            return;
+        }
+
+        char base { Keep };
+        if (cp >= 0xc0 && cp < 0x100) {
+            base = Latin1[cp - 0xc0];
+        } else if (cp >= 0x100 && cp < 0x180) {
+            base = LatinExtA[cp - 0x100];
+        }
+        if (base != Keep) {
+            buf.push_back(base);
+            return;
+        }
+
+        switch (cp) {
+            case 0xc6: case 0xe6:   buf.append("ae"); return;
+            case 0xdf:              buf.append("ss"); return;
+            case 0x152: case 0x153: buf.append("oe"); return;
+        }
+
+        if ((cp >= 0x391 && cp <= 0x3a9) || (cp >= 0x410 && cp <= 0x42f)) {
+            /* Greek and Cyrillic capitals */
+            cp += 0x20;
+        } else if (cp >= 0x400 && cp <= 0x40f) {
+            cp += 0x50;
+        }
+        buf.push_back(static_cast<char>(0xc0 | cp >> 6));
+        buf.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    }
+}
+
+bool
+SearchKey::isPlain(const char * s, size_t len)
+{
+    size_t i { 0 };
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, s + i, sizeof w);
+        if ((w & High) | upper(w)) {
+            return false;
+        }
+    }
+
+    /* the tail, padded with zeroes */
+    uint64_t w { 0 };
+    memcpy(&w, s + i, len - i);
+    return ((w & High) | upper(w)) == 0;
+}
+
+const char *
+SearchKey::folded(const char * s, string& buf)
+{
+    if (isPlain(s, strlen(s))) {
+        return s;
+    }
+
+    buf.clear();
+    for (auto p = reinterpret_cast<const unsigned char *>(s); *p; ) {
+        if (*p < 0x80) {
+            buf.push_back(tolower(*p++));
+        } else if (*p >= 0xc2 && *p <= 0xdf && (p[1] & 0xc0) == 0x80) {
+            /* all of the above is encoded on two bytes, anything longer is kept */
+            fold((p[0] & 0x1f) << 6 | (p[1] & 0x3f), buf);
+            p += 2;
+        } else {
+            buf.push_back(*p++);
+        }
+    }
+    return buf.c_str();
+}
+
+const char *
+SearchKey::initials(const char * s, string& buf)
+{
+    string raw;
+    size_t words { 0 };
+
+    /* of the command only, for a command line */
+    for (const char * p = s; *p && !isspace(static_cast<unsigned char>(*p)); ++p) {
+        auto c = static_cast<unsigned char>(*p);
+        if (isSeparator(c) || (c & 0xc0) == 0x80) {
+            continue;
+        }
+        bool start { p == s || isSeparator(p[-1]) ||
+                     (isupper(c) && islower(static_cast<unsigned char>(p[-1]))) };
+        if (start) {
+            ++words;
+            raw.push_back(c);
+            while ((static_cast<unsigned char>(p[1]) & 0xc0) == 0x80) {
+                raw.push_back(*++p);
+            }
+        }
+    }
+    if (words < 2) {
+        return nullptr;
+    }
+
+    if (folded(raw.c_str(), buf) == raw.c_str()) {
+        buf.swap(raw);
+    }
+    return buf.c_str();
+}
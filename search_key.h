@@ -0,0 +1,56 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SEARCH_KEY_H
+#define SEARCH_KEY_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * The keys names are searched by. Folded keys ignore case and diacritics:
+ * "Émile" and "emile" have the same key. Letters of the Latin-1 and Latin
+ * Extended-A blocks lose their accents as with a canonical decomposition,
+ * Greek and Cyrillic capitals are lowercased and combining marks dropped;
+ * anything else is kept as it is. Most names are plain lowercase ASCII,
+ * which is checked eight bytes at a time, and are their own key.
+ */
+class SearchKey {
+    public:
+        /* the folded key of s, either s itself or in buf */
+        static const char * folded(const char * s, std::string& buf);
+
+        /*
+         * The folded initials of a command made of several words, split at
+         * '-', '_', '.' and where a lowercase letter is followed by an
+         * uppercase one, or nullptr for a single word.
+         */
+        static const char * initials(const char * s, std::string& buf);
+
+        /* whether the len bytes of s are ASCII without uppercase letters */
+        static bool isPlain(const char * s, size_t len);
+};
+
+#endif /* !SEARCH_KEY_H */
@@ -0,0 +1,396 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "shell_lexer.h"
+#include "util.h"
+
+namespace {
+
+bool
+isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+bool
+isMeta(char c)
+{
+    return c && strchr("|&;()<>", c);
+}
+
+bool
+isName(char c)
+{
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+/* the character at pos, or nul past the end */
+char
+at(const string& line, size_t pos)
+{
+    return pos < line.size() ? line[pos] : '\0';
+}
+
+/* a $ starting a variable: $name, ${...} or one of the special parameters */
+bool
+startsVariable(const string& line, size_t pos)
+{
+    auto c = at(line, pos + 1);
+    return isName(c) || (c && strchr("{?$!#@*-", c));
+}
+
+/* the end of the variable at pos */
+size_t
+variableEnd(const string& line, size_t pos)
+{
+    auto q = pos + 1;
+    if (at(line, q) == '{') {
+        q = line.find('}', q);
+        return q == string::npos ? line.size() : q + 1;
+    }
+    if (!isName(at(line, q)) || isdigit(static_cast<unsigned char>(line[q]))) {
+        return q + 1;
+    }
+    while (isName(at(line, q))) {
+        ++q;
+    }
+    return q;
+}
+
+/* the end of the redirection operator at pos, or pos if there is none */
+size_t
+redirectEnd(const string& line, size_t pos)
+{
+    auto q = pos;
+    if (at(line, q) == '&' && at(line, q + 1) == '>') {
+        q += 2;
+        return at(line, q) == '>' ? q + 1 : q;
+    }
+    while (isdigit(static_cast<unsigned char>(at(line, q)))) {
+        ++q;
+    }
+    auto c = at(line, q);
+    if (c != '<' && c != '>') {
+        return pos;
+    }
+    auto d = at(line, ++q);
+    if (d == c || d == '&' || (c == '>' && d == '|') || (c == '<' && d == '>')) {
+        ++q;
+    }
+    /* duplicating a descriptor, or closing one, names it right away */
+    if (d == '&') {
+        if (at(line, q) == '-') {
+            return q + 1;
+        }
+        while (isdigit(static_cast<unsigned char>(at(line, q)))) {
+            ++q;
+        }
+    }
+    return q;
+}
+
+/* the end of the operator at pos */
+size_t
+operatorEnd(const string& line, size_t pos)
+{
+    auto c = line[pos];
+    auto d = at(line, pos + 1);
+    if ((c == '|' && (d == '|' || d == '&')) || (c == '&' && d == '&') || (c == ';' && d == ';')) {
+        return pos + 2;
+    }
+    return pos + 1;
+}
+
+/* the end of the double quoted text at pos; sets closed if it ends the quotes */
+size_t
+quotedEnd(const string& line, size_t pos, bool& closed)
+{
+    closed = false;
+    auto q = pos;
+    while (q < line.size()) {
+        auto c = line[q];
+        if (c == '\\') {
+            q += 2;
+        } else if (c == '"' && q > pos) {
+            closed = true;
+            return q + 1;
+        } else if (c == '$' && q > pos && startsVariable(line, q)) {
+            break;
+        } else {
+            ++q;
+        }
+    }
+    return min(q, line.size());
+}
+
+/* the end of the unquoted word at pos */
+size_t
+wordEnd(const string& line, size_t pos)
+{
+    auto q = pos;
+    while (q < line.size()) {
+        auto c = line[q];
+        if (isBlank(c) || isMeta(c) || strchr("'\"`$", c)) {
+            break;
+        }
+        q += c == '\\' ? 2 : 1;
+    }
+    return max(min(q, line.size()), pos + 1);
+}
+
+}
+
+ShellLexer::ShellLexer()
+    : m_tokens(Util::CommandReserve),
+      m_gapFirst { 0 },
+      m_gapLast { m_tokens.size() },
+      m_length { 0 }
+{ }
+
+ShellLexer::~ShellLexer()
+{
+    // nothing to do...
+}
+
+/* lex the token at pos, returning the state following it */
+uint8_t
+ShellLexer::next(const string& line, size_t pos, uint8_t state, Token& token)
+{
+    state = scan(line, pos, state, token) & ~State_Joined;
+    switch (token.kind) {
+        case Tok_Blank:
+        case Tok_Operator:
+        case Tok_Redirect:
+        case Tok_Comment:
+            return state;
+        default:
+            return state | State_Joined;
+    }
+}
+
+/* as next(), but tracking whether a word is under way is left to it */
+uint8_t
+ShellLexer::scan(const string& line, size_t pos, uint8_t state, Token& token)
+{
+    token.first = pos;
+    token.state = state;
+    const uint8_t args = state & ~(State_Command | State_Target);
+    size_t q;
+    auto c = line[pos];
+
+    if (state & State_Double) {
+        if (c == '$' && startsVariable(line, pos)) {
+            token.last = variableEnd(line, pos);
+            token.kind = Tok_Variable;
+            return state;
+        }
+        bool closed { true };
+        token.last = c == '"' ? pos + 1 : quotedEnd(line, pos, closed);
+        token.kind = Tok_Quoted;
+        return closed ? state & ~State_Double : state;
+    }
+
+    if (isBlank(c)) {
+        for (q = pos; q < line.size() && isBlank(line[q]); ++q) {
+        }
+        token.last = q;
+        token.kind = Tok_Blank;
+        return state;
+    }
+
+    if (c == '#' && !(state & State_Joined)) {
+        token.last = line.size();
+        token.kind = Tok_Comment;
+        return state;
+    }
+
+    if ((q = redirectEnd(line, pos)) != pos) {
+        token.last = q;
+        token.kind = Tok_Redirect;
+        /* a file name follows, unless the descriptor was given */
+        return strchr("&<>|", line[q - 1]) ? state | State_Target : state;
+    }
+
+    if (isMeta(c)) {
+        token.last = operatorEnd(line, pos);
+        token.kind = Tok_Operator;
+        return c == ')' ? args : args | State_Command;
+    }
+
+    if (c == '\'' || c == '`') {
+        q = line.find(c, pos + 1);
+        token.last = q == string::npos ? line.size() : q + 1;
+        token.kind = Tok_Quoted;
+        return args;
+    }
+
+    if (c == '"') {
+        bool closed;
+        token.last = quotedEnd(line, pos, closed);
+        token.kind = Tok_Quoted;
+        return closed || token.last == line.size() ? args : args | State_Double;
+    }
+
+    if (c == '$') {
+        if (at(line, pos + 1) == '(') {
+            token.last = pos + 2;
+            token.kind = Tok_Operator;
+            return args | State_Command;
+        }
+        if (startsVariable(line, pos)) {
+            token.last = variableEnd(line, pos);
+            token.kind = Tok_Variable;
+            return args;
+        }
+    }
+
+    token.last = wordEnd(line, pos);
+    if (state & State_Target) {
+        token.kind = Tok_Word;
+        return state & ~State_Target;
+    }
+    if (state & State_Command) {
+        for (q = pos; q < token.last && isName(line[q]); ++q) {
+        }
+        if (q > pos && q < token.last && line[q] == '=' && !isdigit(static_cast<unsigned char>(c))) {
+            token.kind = Tok_Assign;
+            return state;
+        }
+        token.kind = Tok_Command;
+        return args;
+    }
+    token.kind = Tok_Word;
+    return state;
+}
+
+ShellLexer::Token
+ShellLexer::flip(Token token, size_t length)
+{
+    /* between offsets from the start of the line and offsets from its end */
+    token.first = length - token.first;
+    token.last = length - token.last;
+    return token;
+}
+
+ShellLexer::Token
+ShellLexer::token(size_t i) const
+{
+    return i < m_gapFirst ? m_tokens[i] : flip(m_tokens[i - m_gapFirst + m_gapLast], m_length);
+}
+
+void
+ShellLexer::moveGapBack()
+{
+    --m_gapFirst;
+    m_tokens[--m_gapLast] = flip(m_tokens[m_gapFirst], m_length);
+}
+
+void
+ShellLexer::moveGapForward()
+{
+    m_tokens[m_gapFirst++] = flip(m_tokens[m_gapLast++], m_length);
+}
+
+void
+ShellLexer::push(const Token& token)
+{
+    if (m_gapFirst == m_gapLast) {
+        /* double, the buffer starts at Util::CommandReserve tokens */
+        auto grow = m_tokens.size();
+        m_tokens.insert(begin(m_tokens) + m_gapLast, grow, Token { });
+        m_gapLast += grow;
+    }
+    m_tokens[m_gapFirst++] = token;
+}
+
+void
+ShellLexer::lex(const string& line)
+{
+    m_gapFirst = 0;
+    m_gapLast = m_tokens.size();
+    m_length = 0;
+    edit(line, 0, 0, line.size());
+}
+
+void
+ShellLexer::edit(const string& line, size_t pos, size_t removed, size_t inserted)
+{
+    if (pos + removed > m_length || line.size() != m_length - removed + inserted) {
+        lex(line);
+        return;
+    }
+
+    /*
+     * Bring the gap to the edit, then a token further back, as where a
+     * token ends can depend on the two characters following it.
+     */
+    while (m_gapFirst > 0 && m_tokens[m_gapFirst - 1].first >= pos) {
+        moveGapBack();
+    }
+    while (m_gapLast < m_tokens.size() && m_length - m_tokens[m_gapLast].first < pos) {
+        moveGapForward();
+    }
+    for (int i = 0; i < 2 && m_gapFirst > 0; ++i) {
+        moveGapBack();
+    }
+
+    size_t p { 0 };
+    uint8_t state { State_Command };
+    if (m_gapLast < m_tokens.size()) {
+        p = m_length - m_tokens[m_gapLast].first;
+        state = m_tokens[m_gapLast].state;
+    }
+
+    /* drop the tokens starting before the end of the edit */
+    while (m_gapLast < m_tokens.size() && m_length - m_tokens[m_gapLast].first < pos + removed) {
+        ++m_gapLast;
+    }
+
+    /* the tokens left past the gap are where they were, from the end */
+    m_length = line.size();
+    while (p < m_length) {
+        Token token;
+        state = next(line, p, state, token);
+        push(token);
+        p = token.last;
+
+        /* stop where the old tokens pick up again, in the same state */
+        while (m_gapLast < m_tokens.size() && m_length - m_tokens[m_gapLast].first < p) {
+            ++m_gapLast;
+        }
+        if (m_gapLast < m_tokens.size() && m_length - m_tokens[m_gapLast].first == p &&
+            m_tokens[m_gapLast].state == state) {
+            return;
+        }
+    }
+    m_gapLast = m_tokens.size();
+}
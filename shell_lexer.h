@@ -0,0 +1,102 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SHELL_LEXER_H
+#define SHELL_LEXER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Splits a command line into shell tokens, for highlighting: blanks, words,
+ * command words, quoted text, variables, operators, redirections and
+ * comments. The tokens cover the whole line, and each one records the state
+ * the lexer was in where it starts, e.g. inside double quotes or expecting
+ * a command. After an edit, lexing restarts at the token the edit touches
+ * and stops as soon as it reaches the start of a token it had before, in
+ * the same state, past the edit.
+ *
+ * The tokens are kept in a gap buffer, the gap following the last edit.
+ * Those past the gap hold their offsets from the end of the line, which an
+ * edit at the gap leaves alone, and moving the gap only costs the tokens it
+ * goes past: typing costs the same however long the line is.
+ */
+class ShellLexer {
+    public:
+        enum Kind : uint8_t {
+            Tok_Blank,
+            Tok_Word,
+            Tok_Command,  /* a word in command position */
+            Tok_Assign,   /* NAME=, ahead of a command */
+            Tok_Quoted,
+            Tok_Variable,
+            Tok_Operator,
+            Tok_Redirect,
+            Tok_Comment
+        };
+
+        struct Token {
+            uint32_t first;
+            uint32_t last;
+            Kind kind;
+            uint8_t state; /* where it starts */
+        };
+
+        ShellLexer();
+        ~ShellLexer();
+
+        /* lex a new line from scratch */
+        void lex(const std::string& line);
+        /* line had removed bytes at pos replaced with inserted ones */
+        void edit(const std::string& line, size_t pos, size_t removed, size_t inserted);
+
+        size_t count() const { return m_gapFirst + m_tokens.size() - m_gapLast; }
+        Token token(size_t i) const;
+        size_t length() const { return m_length; }
+
+    private:
+        enum State : uint8_t {
+            State_Command = 1, /* the next word is a command */
+            State_Double  = 2, /* inside double quotes */
+            State_Target  = 4, /* the next word is the target of a redirection */
+            State_Joined  = 8  /* the text so far ends in the middle of a word */
+        };
+
+        static uint8_t next(const std::string& line, size_t pos, uint8_t state, Token& token);
+        static uint8_t scan(const std::string& line, size_t pos, uint8_t state, Token& token);
+        static Token flip(Token token, size_t length);
+        void moveGapBack();
+        void moveGapForward();
+        void push(const Token& token);
+
+    private:
+        std::vector<Token> m_tokens; /* the gap is [m_gapFirst, m_gapLast) */
+        size_t m_gapFirst;
+        size_t m_gapLast;
+        size_t m_length;
+};
+
+#endif /* !SHELL_LEXER_H */
@@ -0,0 +1,247 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+#include "snapshot.h"
+#include "util.h"
+
+namespace {
+    constexpr char     SnapshotMagic[8] { 'T', 'L', 'S', 'N', 'A', 'P', '\0', '\0' };
+    constexpr uint32_t SnapshotVersion  { 4 };
+}
+
+struct Snapshot::Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t sections;
+};
+
+struct Snapshot::SectionInfo {
+    uint64_t fingerprint;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+Snapshot::Snapshot()
+    : m_snapshotFile { Util::getEnv("HOME") + "/.thingylaunch.cache" },
+      m_map { nullptr },
+      m_mapSize { 0 },
+      m_dirty { false },
+      m_updated { },
+      m_fingerprints { }
+{
+    int fd { open(m_snapshotFile.c_str(), O_RDONLY) };
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || sb.st_size < static_cast<off_t>(sizeof(Header) + Sec_Count * sizeof(SectionInfo))) {
+        close(fd);
+        return;
+    }
+
+    void * map { mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+
+    m_map = static_cast<const char *>(map);
+    m_mapSize = sb.st_size;
+
+    /* validate the header and the section table before trusting any offset */
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    bool valid { memcmp(hdr->magic, SnapshotMagic, sizeof SnapshotMagic) == 0 &&
+                 hdr->version == SnapshotVersion && hdr->sections == Sec_Count };
+    auto info = reinterpret_cast<const SectionInfo *>(m_map + sizeof(Header));
+    for (int i = 0; valid && i < Sec_Count; ++i) {
+        valid = info[i].offset <= m_mapSize && info[i].size <= m_mapSize - info[i].offset;
+    }
+
+    if (!valid) {
+        munmap(map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+}
+
+Snapshot::~Snapshot()
+{
+    if (m_map) {
+        munmap(const_cast<char *>(m_map), m_mapSize);
+    }
+}
+
+const Snapshot::SectionInfo *
+Snapshot::section(Section sec) const
+{
+    if (m_map == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<const SectionInfo *>(m_map + sizeof(Header)) + sec;
+}
+
+bool
+Snapshot::lookup(Section sec, uint64_t fingerprint, ArenaVector<const char *>& entries) const
+{
+    auto info = section(sec);
+    if (info == nullptr || info->fingerprint != fingerprint) {
+        return false;
+    }
+
+    entries.clear();
+    entries.reserve(info->count);
+
+    /* entries are stored as a 32-bit length followed by the NUL-terminated bytes */
+    const char * p { m_map + info->offset };
+    const char * e { p + info->size };
+    for (uint32_t i = 0; i < info->count; ++i) {
+        uint32_t len;
+        if (static_cast<size_t>(e - p) < sizeof len) {
+            break;
+        }
+        memcpy(&len, p, sizeof len);
+        p += sizeof len;
+        if (static_cast<size_t>(e - p) <= len || p[len] != '\0') {
+            break;
+        }
+        entries.push_back(p);
+        p += len + 1;
+    }
+
+    if (entries.size() != info->count) {
+        entries.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void
+Snapshot::update(Section sec, uint64_t fingerprint, const ArenaVector<const char *>& entries)
+{
+    m_updated[sec] = true;
+    m_fingerprints[sec] = fingerprint;
+    m_pending[sec].assign(begin(entries), end(entries));
+    m_dirty = true;
+}
+
+void
+Snapshot::save()
+{
+    if (!m_dirty) {
+        return;
+    }
+
+    Header hdr;
+    memcpy(hdr.magic, SnapshotMagic, sizeof SnapshotMagic);
+    hdr.version = SnapshotVersion;
+    hdr.sections = Sec_Count;
+
+    SectionInfo info[Sec_Count] { };
+    string buf(sizeof hdr + sizeof info, '\0');
+
+    for (int i = 0; i < Sec_Count; ++i) {
+        auto sec = static_cast<Section>(i);
+        info[i].offset = buf.size();
+        if (m_updated[i]) {
+            info[i].fingerprint = m_fingerprints[i];
+            info[i].count = m_pending[i].size();
+            for (const auto& entry : m_pending[i]) {
+                uint32_t len = entry.size();
+                buf.append(reinterpret_cast<const char *>(&len), sizeof len);
+                buf.append(entry.c_str(), len + 1);
+            }
+        } else if (auto old = section(sec)) {
+            /* carry over sections that are still current */
+            info[i].fingerprint = old->fingerprint;
+            info[i].count = old->count;
+            buf.append(m_map + old->offset, old->size);
+        }
+        info[i].size = buf.size() - info[i].offset;
+    }
+
+    memcpy(&buf[0], &hdr, sizeof hdr);
+    memcpy(&buf[sizeof hdr], info, sizeof info);
+
+    /* a launcher starting meanwhile maps the old snapshot or the new one, never a mix */
+    string tmpFile;
+    FILE * out { Util::createTemp(m_snapshotFile, tmpFile) };
+    if (out == nullptr) {
+        return;
+    }
+
+    bool ok { fwrite(buf.data(), 1, buf.size(), out) == buf.size() };
+    ok = fclose(out) == 0 && ok;
+
+    if (ok && rename(tmpFile.c_str(), m_snapshotFile.c_str()) == 0) {
+        m_dirty = false;
+    } else {
+        unlink(tmpFile.c_str());
+    }
+}
+
+uint64_t
+Snapshot::hash(const void * data, size_t len, uint64_t seed)
+{
+    /* FNV-1a */
+    auto p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < len; ++i) {
+        seed ^= p[i];
+        seed *= 1099511628211ULL;
+    }
+    return seed;
+}
+
+uint64_t
+Snapshot::stamp(const string& fileName, uint64_t seed)
+{
+    seed = hash(fileName.c_str(), fileName.size() + 1, seed);
+
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) == -1) {
+        return seed;
+    }
+
+    uint64_t meta[] {
+        static_cast<uint64_t>(sb.st_dev),
+        static_cast<uint64_t>(sb.st_ino),
+        static_cast<uint64_t>(sb.st_size),
+        static_cast<uint64_t>(sb.st_mtim.tv_sec),
+        static_cast<uint64_t>(sb.st_mtim.tv_nsec)
+    };
+    return hash(meta, sizeof meta, seed);
+}
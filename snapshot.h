@@ -0,0 +1,79 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+
+/*
+ * A single versioned, mmap'ed file caching everything the launcher loads at
+ * startup. Each section is tagged with a fingerprint of its sources, and is
+ * only used if the fingerprint computed at startup still matches. Entries
+ * returned by lookup() point into the mapping and live as long as the
+ * Snapshot object.
+ */
+class Snapshot {
+    public:
+        enum Section {
+            Sec_Completion,
+            Sec_History,
+            Sec_Bookmarks,
+            Sec_Count
+        };
+
+        Snapshot();
+        ~Snapshot();
+        bool lookup(Section sec, uint64_t fingerprint, ArenaVector<const char *>& entries) const;
+        void update(Section sec, uint64_t fingerprint, const ArenaVector<const char *>& entries);
+        void save();
+
+        static uint64_t hash(const void * data, size_t len, uint64_t seed = HashSeed);
+        static uint64_t stamp(const std::string& fileName, uint64_t seed = HashSeed);
+
+    private:
+        struct Header;
+        struct SectionInfo;
+
+        const SectionInfo * section(Section sec) const;
+
+    private:
+        static constexpr uint64_t HashSeed { 14695981039346656037ULL };
+
+        std::string m_snapshotFile;
+        const char * m_map;
+        size_t m_mapSize;
+
+        bool m_dirty;
+        bool m_updated[Sec_Count];
+        uint64_t m_fingerprints[Sec_Count];
+        std::vector<std::string> m_pending[Sec_Count];
+};
+
+#endif /* !SNAPSHOT_H */
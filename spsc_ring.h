@@ -0,0 +1,92 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/*
+ * A bounded, lock-free single-producer, single-consumer ring buffer. The
+ * producer and the consumer each own an index on a cache line of its own,
+ * and keep a copy of the other one's index, reloading it only when the ring
+ * looks full or empty.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        SpscRing()
+            : m_head { 0 },
+              m_tail { 0 },
+              m_cachedHead { 0 },
+              m_cachedTail { 0 }
+        { }
+
+        /* producer side, fails when the ring is full */
+        bool
+        push(const T& value)
+        {
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cachedHead == Capacity) {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail - m_cachedHead == Capacity) {
+                    return false;
+                }
+            }
+            m_slots[tail & (Capacity - 1)] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /* consumer side, fails when the ring is empty */
+        bool
+        pop(T& value)
+        {
+            auto head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cachedTail) {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cachedTail) {
+                    return false;
+                }
+            }
+            value = m_slots[head & (Capacity - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        static constexpr size_t CacheLine { 64 };
+
+        alignas(CacheLine) std::atomic<size_t> m_head; /* written by the consumer */
+        alignas(CacheLine) std::atomic<size_t> m_tail; /* written by the producer */
+        alignas(CacheLine) size_t m_cachedHead;        /* producer's copy of m_head */
+        alignas(CacheLine) size_t m_cachedTail;        /* consumer's copy of m_tail */
+        alignas(CacheLine) T m_slots[Capacity];
+};
+
+#endif /* !SPSC_RING_H */
@@ -0,0 +1,269 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include "snapshot.h"
+#include "system_index.h"
+#include "util.h"
+
+namespace {
+    constexpr char     IndexMagic[8] { 'T', 'L', 'S', 'Y', 'S', 'I', 'D', 'X' };
+    constexpr uint32_t IndexVersion  { 1 };
+}
+
+struct SystemIndex::Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t dirs;
+    uint64_t entries;
+    uint64_t strings; /* offset of the string pool */
+};
+
+struct SystemIndex::DirInfo {
+    uint64_t stamp;
+    uint32_t path;    /* in the string pool */
+    uint32_t first;   /* first entry */
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct SystemIndex::Entry {
+    uint32_t name;    /* in the string pool */
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+};
+
+SystemIndex::SystemIndex()
+    : m_map { nullptr },
+      m_mapSize { 0 },
+      m_stamp { Snapshot::stamp(indexFile()) }
+{
+    /* stamped first, a rebuild from now on makes us stale rather than missed */
+    int fd { open(indexFile().c_str(), O_RDONLY) };
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || sb.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        return;
+    }
+
+    /* shared, so that all users are served by the same pages */
+    void * map { mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0) };
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+
+    m_map = static_cast<const char *>(map);
+    m_mapSize = sb.st_size;
+
+    /* validate the header, the tables and their references before trusting any offset */
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    uint64_t tables { sizeof(Header) + hdr->dirs * sizeof(DirInfo) + hdr->entries * sizeof(Entry) };
+    bool valid { memcmp(hdr->magic, IndexMagic, sizeof IndexMagic) == 0 &&
+                 hdr->version == IndexVersion &&
+                 hdr->dirs < m_mapSize && hdr->entries < m_mapSize &&
+                 tables <= hdr->strings && hdr->strings < m_mapSize &&
+                 m_map[m_mapSize - 1] == '\0' };
+
+    auto poolSize = m_mapSize - hdr->strings;
+    auto dirs = reinterpret_cast<const DirInfo *>(m_map + sizeof(Header));
+    for (uint32_t i = 0; valid && i < hdr->dirs; ++i) {
+        valid = dirs[i].path < poolSize && dirs[i].first <= hdr->entries &&
+                dirs[i].count <= hdr->entries - dirs[i].first;
+    }
+    auto entries = reinterpret_cast<const Entry *>(dirs + hdr->dirs);
+    for (uint64_t i = 0; valid && i < hdr->entries; ++i) {
+        valid = entries[i].name < poolSize;
+    }
+
+    if (!valid) {
+        munmap(map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+}
+
+SystemIndex::~SystemIndex()
+{
+    if (m_map) {
+        munmap(const_cast<char *>(m_map), m_mapSize);
+    }
+}
+
+string
+SystemIndex::indexFile()
+{
+    const char * file { getenv("THINGYLAUNCH_SYSTEM_INDEX") };
+    return file ? file : TL_SYSTEM_INDEX;
+}
+
+bool
+SystemIndex::stale() const
+{
+    /* the rebuilt file is renamed into place, a new inode changes the stamp */
+    return Snapshot::stamp(indexFile()) != m_stamp;
+}
+
+const SystemIndex::DirInfo *
+SystemIndex::find(const string& dir) const
+{
+    if (m_map == nullptr) {
+        return nullptr;
+    }
+
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    auto dirs = reinterpret_cast<const DirInfo *>(m_map + sizeof(Header));
+    auto pool = m_map + hdr->strings;
+    for (uint32_t i = 0; i < hdr->dirs; ++i) {
+        if (dir == pool + dirs[i].path) {
+            return &dirs[i];
+        }
+    }
+    return nullptr;
+}
+
+bool
+SystemIndex::covers(const string& dir) const
+{
+    auto info = find(dir);
+    return info && info->stamp == Snapshot::stamp(dir);
+}
+
+void
+SystemIndex::lookup(const string& dir, uid_t uid, gid_t gid, vector<const char *>& names) const
+{
+    auto info = find(dir);
+    if (info == nullptr) {
+        return;
+    }
+
+    auto hdr = reinterpret_cast<const Header *>(m_map);
+    auto entries = reinterpret_cast<const Entry *>(m_map + sizeof(Header) + hdr->dirs * sizeof(DirInfo));
+    auto pool = m_map + hdr->strings;
+    for (uint32_t i = info->first; i < info->first + info->count; ++i) {
+        const auto& e = entries[i];
+        if (Util::isExecutable(e.mode, e.uid, e.gid, uid, gid)) {
+            names.push_back(pool + e.name);
+        }
+    }
+}
+
+bool
+SystemIndex::build(const vector<string>& dirs, const string& fileName)
+{
+    vector<DirInfo> dirInfos;
+    vector<Entry> entries;
+    string pool;
+
+    auto intern = [&pool] (const char * s) {
+        uint32_t off = pool.size();
+        pool.append(s, strlen(s) + 1);
+        return off;
+    };
+
+    struct stat sb;
+    string currentPath;
+    for (const auto& dir : dirs) {
+
+        DIR * dirp { opendir(dir.c_str()) };
+        if (dirp == nullptr) {
+            continue;
+        }
+
+        /* stamp before scanning, a change while we scan makes the entry stale rather than wrong */
+        DirInfo info { Snapshot::stamp(dir), intern(dir.c_str()), static_cast<uint32_t>(entries.size()), 0, 0 };
+
+        vector<pair<string, struct stat>> files;
+        struct dirent * dp;
+        while ((dp = readdir(dirp))) {
+            currentPath.assign(dir).append(1, '/').append(dp->d_name);
+            if (stat(currentPath.c_str(), &sb) == 0 && S_ISREG(sb.st_mode) &&
+                (sb.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)))
+            {
+                files.emplace_back(dp->d_name, sb);
+            }
+        }
+        closedir(dirp);
+
+        sort(begin(files), end(files),
+                [] (const pair<string, struct stat>& a, const pair<string, struct stat>& b) { return a.first < b.first; });
+        for (const auto& f : files) {
+            entries.push_back(Entry { intern(f.first.c_str()), static_cast<uint32_t>(f.second.st_mode),
+                    static_cast<uint32_t>(f.second.st_uid), static_cast<uint32_t>(f.second.st_gid) });
+        }
+        info.count = entries.size() - info.first;
+        dirInfos.push_back(info);
+    }
+
+    Header hdr;
+    memcpy(hdr.magic, IndexMagic, sizeof IndexMagic);
+    hdr.version = IndexVersion;
+    hdr.dirs = dirInfos.size();
+    hdr.entries = entries.size();
+    hdr.strings = sizeof hdr + dirInfos.size() * sizeof(DirInfo) + entries.size() * sizeof(Entry);
+    if (pool.empty()) {
+        pool.push_back('\0');
+    }
+
+    /* the launchers of all users map the index; a complete one is renamed over it */
+    auto slash = fileName.rfind('/');
+    if (slash != string::npos && slash != 0) {
+        mkdir(fileName.substr(0, slash).c_str(), 0755);
+    }
+    string tmpFile;
+    FILE * out { Util::createTemp(fileName, tmpFile) };
+    if (out == nullptr) {
+        return false;
+    }
+    fchmod(fileno(out), 0644);
+
+    bool ok { fwrite(&hdr, sizeof hdr, 1, out) == 1 &&
+              fwrite(dirInfos.data(), sizeof(DirInfo), dirInfos.size(), out) == dirInfos.size() &&
+              fwrite(entries.data(), sizeof(Entry), entries.size(), out) == entries.size() &&
+              fwrite(pool.data(), 1, pool.size(), out) == pool.size() };
+    ok = fclose(out) == 0 && ok;
+
+    if (!ok || rename(tmpFile.c_str(), fileName.c_str()) != 0) {
+        unlink(tmpFile.c_str());
+        return false;
+    }
+    return true;
+}
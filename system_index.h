@@ -0,0 +1,69 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SYSTEM_INDEX_H
+#define SYSTEM_INDEX_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+
+/*
+ * A read-only, mmap'ed index of the files in directories shared by all users,
+ * such as /usr/bin, built by an administrator with -build-system-index. All
+ * launchers on a machine map the same file, so the names live once in the
+ * page cache. Each directory is tagged with its stamp at build time and only
+ * used while it's unchanged; file modes and owners are stored, so that each
+ * user picks the files executable by them.
+ */
+class SystemIndex {
+    public:
+        SystemIndex();
+        ~SystemIndex();
+        bool stale() const; /* the file was rebuilt or removed since it was mapped */
+        bool covers(const std::string& dir) const;
+        void lookup(const std::string& dir, uid_t uid, gid_t gid, std::vector<const char *>& names) const;
+
+        static std::string indexFile();
+        static bool build(const std::vector<std::string>& dirs, const std::string& fileName);
+
+    private:
+        struct Header;
+        struct DirInfo;
+        struct Entry;
+
+        const DirInfo * find(const std::string& dir) const;
+
+    private:
+        const char * m_map;
+        size_t m_mapSize;
+        uint64_t m_stamp;
+};
+
+#endif /* !SYSTEM_INDEX_H */
@@ -0,0 +1,89 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+using namespace std;
+
+#include "task_stats.h"
+
+namespace {
+
+    struct Entry {
+        const char * name;
+        int lane;
+        unsigned long count;
+        unsigned long waitUs;
+        unsigned long runUs;
+        unsigned long maxRunUs;
+    };
+
+    constexpr int MaxEntries { 16 };
+
+    /* static storage, so that accounting never allocates itself */
+    Entry g_entries[MaxEntries] { };
+    int g_used { 0 };
+    mutex g_mutex;
+}
+
+void
+TaskStats::record(const char * name, int lane, unsigned long waitUs, unsigned long runUs)
+{
+    lock_guard<mutex> lock { g_mutex };
+
+    Entry * e { nullptr };
+    for (int i = 0; i < g_used; ++i) {
+        if (g_entries[i].lane == lane && strcmp(g_entries[i].name, name) == 0) {
+            e = &g_entries[i];
+            break;
+        }
+    }
+    if (e == nullptr) {
+        if (g_used == MaxEntries) {
+            return;
+        }
+        e = &g_entries[g_used++];
+        e->name = name;
+        e->lane = lane;
+    }
+
+    ++e->count;
+    e->waitUs += waitUs;
+    e->runUs += runUs;
+    e->maxRunUs = max(e->maxRunUs, runUs);
+}
+
+void
+TaskStats::report()
+{
+    lock_guard<mutex> lock { g_mutex };
+    for (int i = 0; i < g_used; ++i) {
+        const auto& e = g_entries[i];
+        fprintf(stderr, "task-stats: %-12s lane %d %6lu runs %8lu us waiting %8lu us running %8lu us max\n",
+                e.name, e.lane, e.count, e.waitUs, e.runUs, e.maxRunUs);
+    }
+}
@@ -27,22 +27,47 @@
 #include <X11/X.h>
 #include <X11/keysym.h>
 
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <libgen.h>
+#include <poll.h>
+#include <signal.h>
 #include <unistd.h>
 
 #include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
-#include <iostream>
+#include <cstring>
 #include <iterator>
-#include <sstream>
 using namespace std;
 
+#include "alloc_stats.h"
+#include "arena.h"
 #include "bookmark.h"
+#include "bookmark_reloader.h"
 #include "completion.h"
+#include "file_completion.h"
+#include "file_index.h"
+#include "fuzzy_search.h"
 #include "history.h"
+#include "line_stream.h"
+#include "providers.h"
+#include "ranker.h"
+#include "shell_lexer.h"
+#include "snapshot.h"
+#include "system_index.h"
+#include "task_stats.h"
+#include "thread_pool.h"
 #include "util.h"
 #include "x11_interface.h"
 
+namespace {
+    /* written to by the SIGUSR1 handler, to show a resident launcher */
+    int g_showPipe[2] { -1, -1 };
+}
+
 class Thingylaunch {
 
     public:
@@ -50,62 +75,167 @@ class Thingylaunch {
         ~Thingylaunch();
 
         void run(int argc, char **argv);
+        static int requestShow();
 
     private:
         void readOptions(int argc, char **argv);
         void setupGC();
         void eventLoop();
+        void setupResident();
+        void control();
+        void show(X11Interface * x11);
+        bool finish();
         void grabKeyboard();
         bool keypress(X11Event& ev);
-        void execcmd();
+        bool chordStep();
+        bool runBookmark();
+        static bool isModifier(uint16_t key);
+        static void showSignal(int);
+        static string controlFile();
+        static bool sameDisplay(const string& a, const string& b);
+        void execcmd(char * const * argv = nullptr);
+        void refreshWindows();
+        void activate();
+        void openFile();
+        void readStream();
+        void searchAhead();
+        void resetCompletion();
+        bool redraw();
         void die(string msg);
+        void quit(int status);
 
         string parseFontDesc();
 
     private:
 
-        /* X11 */
+        /* X11, one connection per display, and the one in use */
+        vector<X11Interface *> m_displays;
         X11Interface * m_x11;
 
         /* User-defined options */
         string m_fgColorName;
         string m_bgColorName;
+        string m_styleColorNames[X11Span::Style_Count];
+        string m_syntaxColorNames;
         vector<string> m_fontDesc;
-
-        /* Completion, history, and bookmarks */
-        Completion m_comp;
+        string m_scriptFile;
+        bool m_resident;
+        bool m_windowMode;
+        bool m_fileMode;
+        bool m_dmenuMode;
+        vector<string> m_displayNames;
+
+        /* Startup arena and snapshot, completion, history, and bookmarks */
+        Arena      m_arena;
+        Snapshot   m_snap;
         History    m_hist;
-        Bookmark   m_book;
+        Bookmark * m_book;
+        ThreadPool m_pool;
+        Completion m_comp;
+        ExecutableProvider * m_execs; /* owned by m_comp */
+
+        /* Window-switcher mode, the clients of the display in use */
+        vector<X11Window> m_windows;
+        bool m_windowsChanged;
+        chrono::steady_clock::time_point m_windowsDeadline;
+        static constexpr int WindowsDelay { 100 }; /* ms */
+
+        /* File-search mode */
+        FileCompletion * m_files;
+
+        /* dmenu mode, the lines read from stdin and the search through them */
+        LineStream * m_lines;
+        FuzzySearch * m_lineSearch;
+        bool m_streaming;
+
+        /* Resident mode */
+        bool m_visible;
+        BookmarkReloader * m_reloader;
+        int m_controlFd;
+        string m_controlPartial; /* a request not yet terminated by a newline */
 
-        /* The command */
+        /* The command, its shell tokens, and how parts of it are drawn */
         string m_command;
         string::size_type m_cursorPos;
+        ShellLexer m_lexer;
+        vector<X11Span> m_spans;
+
+        /* The bookmark chord being typed */
+        Bookmark::Cursor m_chord;
+        chrono::steady_clock::time_point m_chordDeadline;
+        static constexpr int ChordTimeout { 1000 }; /* ms */
+
+        /* How many fuzzy matches Tab cycles through, in dmenu mode */
+        static constexpr size_t MatchLimit { 64 };
+
+        /* The program files are opened with */
+        static constexpr const char * Opener { "xdg-open" };
 
         /* The window size */
         static constexpr int WindowWidth { 640 };
         static constexpr int WindowHeight { 25 };
 };
 
+/* chrono takes them by reference */
+constexpr int Thingylaunch::ChordTimeout;
+constexpr int Thingylaunch::WindowsDelay;
+
 Thingylaunch::Thingylaunch()
-    : m_x11 { X11Interface::create() },
+    : m_x11 { nullptr },
       m_fgColorName { "white" },
       m_bgColorName { "black" },
+      m_styleColorNames { "", "green", "red", "yellow", "cyan", "magenta", "orange", "gray" },
       m_fontDesc { "*", "*", "medium", "r", "*", "*", "15", "*", "*", "*", "*", "*", "*", "*" },
-      m_cursorPos { 0 }
-{ }
+      m_resident { false },
+      m_windowMode { false },
+      m_fileMode { false },
+      m_dmenuMode { false },
+      m_hist { m_snap, m_arena },
+      m_book { new Bookmark { m_snap, m_arena } },
+      m_comp { m_pool },
+      m_execs { nullptr },
+      m_windowsChanged { false },
+      m_files { nullptr },
+      m_lines { nullptr },
+      m_lineSearch { nullptr },
+      m_streaming { false },
+      m_visible { true },
+      m_reloader { nullptr },
+      m_controlFd { -1 },
+      m_cursorPos { 0 },
+      m_chord { Bookmark::Root }
+{
+    m_command.reserve(Util::CommandReserve);
+    m_spans.reserve(Util::CommandReserve);
+
+    /* refresh any stale section, so the next start is a single mmap */
+    m_snap.save();
+}
 
 Thingylaunch::~Thingylaunch()
 {
-    delete m_x11;
+    delete m_reloader;
+    delete m_files;
+    delete m_lineSearch;
+    delete m_lines;
+    delete m_book;
+    for (auto x11 : m_displays) {
+        delete x11;
+    }
+
+    if (m_controlFd != -1) {
+        close(m_controlFd);
+        unlink(controlFile().c_str());
+    }
 }
 
 string
 Thingylaunch::parseFontDesc()
 {
-    stringstream ss;
+    string desc;
     for (auto& i : m_fontDesc)
-        ss << "-" << i;
-    return ss.str();
+        desc.append(1, '-').append(i);
+    return desc;
 }
 
 void
@@ -113,24 +243,331 @@ Thingylaunch::run(int argc, char **argv)
 {
     readOptions(argc, argv);
 
-    if (!m_x11->createWindow(WindowWidth, WindowHeight)) {
-        die("Couldn't open window");
+    /* gather completion candidates in the background, while we connect to X */
+    if (m_fileMode) {
+        m_files = new FileCompletion { m_pool };
+        m_files->refresh();
+    } else if (m_dmenuMode) {
+        /* stdin is read as it comes, along with X events */
+        fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+        m_lines = new LineStream { STDIN_FILENO };
+        m_lineSearch = new FuzzySearch { m_pool, MatchLimit };
+        m_lineSearch->setSource(m_lines);
+        m_streaming = true;
+    } else if (m_windowMode) {
+        m_comp.setRemembering(false);
+    } else {
+        m_execs = new ExecutableProvider { m_snap };
+        m_comp.addProvider(m_execs);
+        m_comp.addProvider(new HistoryProvider { m_hist });
+        m_comp.addProvider(new BookmarkProvider { *m_book });
+    }
+
+    if (m_displayNames.empty()) {
+        m_displayNames.push_back("");
+    }
+
+    if (m_scriptFile.empty()) {
+        for (const auto& name : m_displayNames) {
+            m_displays.push_back(X11Interface::create(name));
+        }
+    } else {
+        m_displays.push_back(X11Interface::createScripted(m_scriptFile));
+        /* replays must not depend on how fast the providers are, nor on how fast stdin is */
+        while (m_streaming) {
+            struct pollfd pfd { STDIN_FILENO, POLLIN, 0 };
+            poll(&pfd, 1, -1);
+            readStream();
+        }
+        m_comp.wait();
+        if (m_files) {
+            m_files->wait();
+        }
+    }
+
+    /* colon separated, in the order of the styles; an empty one keeps the default */
+    string::size_type from { 0 };
+    for (int style = X11Span::Style_Quoted; style < X11Span::Style_Count && from <= m_syntaxColorNames.size(); ++style) {
+        auto to = min(m_syntaxColorNames.find(':', from), m_syntaxColorNames.size());
+        if (to != from) {
+            m_styleColorNames[style] = m_syntaxColorNames.substr(from, to - from);
+        }
+        from = to + 1;
     }
 
-    if (!m_x11->setupGC(m_bgColorName, m_fgColorName, parseFontDesc())) {
-        die("Couldn't setup GC");
+    for (auto x11 : m_displays) {
+        if (!x11->createWindow(WindowWidth, WindowHeight)) {
+            die("Couldn't open window");
+        }
+
+        if (!x11->setupGC(m_bgColorName, m_fgColorName, parseFontDesc())) {
+            die("Couldn't setup GC");
+        }
+        for (int style = X11Span::Style_Default + 1; style < X11Span::Style_Count; ++style) {
+            if (!x11->setupStyle(static_cast<X11Span::Style>(style), m_styleColorNames[style])) {
+                die("Couldn't setup GC");
+            }
+        }
+
+        /* start on the first display, the others wait to be asked for */
+        if (x11 != m_displays.front()) {
+            x11->hide();
+        }
     }
+    m_x11 = m_displays.front();
 
     if (!m_x11->grabKeyboard()) {
         die ("Couldn't grab keyboard");
     }
 
+    if (m_windowMode) {
+        refreshWindows();
+    }
+
+    if (m_resident) {
+        setupResident();
+    }
+
     eventLoop();
+    quit(0);
+}
+
+void
+Thingylaunch::setupResident()
+{
+    if (pipe(g_showPipe) == -1) {
+        die("Couldn't create pipe");
+    }
+    for (auto fd : g_showPipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = showSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    /* let the kernel reap the commands we launch */
+    signal(SIGCHLD, SIG_IGN);
+
+    m_reloader = new BookmarkReloader { m_pool };
+
+    /*
+     * Requests to show on a given display come through a FIFO. It's opened
+     * for writing too, so that it never reports end-of-file between writers.
+     */
+    auto file = controlFile();
+    if (mkfifo(file.c_str(), 0600) == -1 && errno != EEXIST) {
+        die("Couldn't create " + file);
+    }
+    m_controlFd = open(file.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m_controlFd == -1) {
+        die("Couldn't open " + file);
+    }
+}
+
+string
+Thingylaunch::controlFile()
+{
+    return Util::getEnv("HOME") + "/.thingylaunch.ctl";
+}
+
+int
+Thingylaunch::requestShow()
+{
+    /* fails right away if no resident launcher is reading */
+    auto file = controlFile();
+    int fd { open(file.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC) };
+    if (fd == -1) {
+        perror(file.c_str());
+        return 1;
+    }
+
+    const char * display { getenv("DISPLAY") };
+    string request { display ? display : "" };
+    request.append(1, '\n');
+    bool ok { write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()) };
+    close(fd);
+
+    return ok ? 0 : 1;
+}
+
+bool
+Thingylaunch::sameDisplay(const string& a, const string& b)
+{
+    /* :1 and :1.0 are the same display */
+    auto base = [] (const string& d) {
+        auto dot = d.rfind('.');
+        auto colon = d.rfind(':');
+        return dot != string::npos && colon != string::npos && dot > colon ? d.substr(0, dot) : d;
+    };
+    return a == b || base(a) == base(b);
+}
+
+void
+Thingylaunch::control()
+{
+    auto request = [this] (const string& line) {
+        const char * env { getenv("DISPLAY") };
+        for (size_t i = 0; !line.empty() && i < m_displays.size() && i < m_displayNames.size(); ++i) {
+            /* the displays we were started without -display for are on $DISPLAY */
+            const auto& name = m_displayNames[i].empty() && env ? string { env } : m_displayNames[i];
+            if (sameDisplay(name, line) && (!m_visible || m_displays[i] != m_x11)) {
+                show(m_displays[i]);
+            }
+        }
+    };
+
+    char buf[256];
+    ssize_t n;
+    while ((n = read(m_controlFd, buf, sizeof buf)) > 0) {
+
+        /* whole requests from the buffer, the rest waits for the next read */
+        const char * line { buf };
+        const char * end { buf + n };
+        while (auto nl = static_cast<const char *>(memchr(line, '\n', end - line))) {
+            m_controlPartial.append(line, nl - line);
+            request(m_controlPartial);
+            m_controlPartial.clear();
+            line = nl + 1;
+        }
+        m_controlPartial.append(line, end - line);
+    }
+}
+
+void
+Thingylaunch::showSignal(int)
+{
+    int saved { errno };
+    ssize_t ignored { write(g_showPipe[1], "", 1) };
+    (void)ignored;
+    errno = saved;
+}
+
+void
+Thingylaunch::show(X11Interface * x11)
+{
+    /* one display at a time, moving there leaves the other one */
+    if (m_visible && x11 != m_x11) {
+        m_x11->hide();
+        m_visible = false;
+    }
+    m_x11 = x11;
+
+    /* pick up the bookmarks reloaded while we were hidden */
+    if (auto book = m_reloader->take()) {
+        delete m_book;
+        m_book = book;
+    }
+
+    /* refresh the completion candidates in the background, replacing the old ones */
+    if (m_windowMode) {
+        refreshWindows();
+    } else if (m_files) {
+        m_files->refresh();
+    } else if (m_lineSearch) {
+        /* the lines read from stdin stay, more may still be streaming in */
+    } else {
+        if (m_execs->stale()) {
+            m_execs = new ExecutableProvider { m_snap };
+            m_comp.addProvider(m_execs);
+        }
+        m_comp.addProvider(new HistoryProvider { m_hist });
+        m_comp.addProvider(new BookmarkProvider { *m_book });
+    }
+
+    m_command.clear();
+    m_cursorPos = 0;
+    m_lexer.lex(m_command);
+    resetCompletion();
+    m_chord = Bookmark::Root;
+
+    m_x11->show();
+    if (!m_x11->grabKeyboard()) {
+        m_x11->hide();
+        return;
+    }
+    m_visible = true;
+
+    if (!redraw()) {
+        die("Couldn't redraw");
+    }
+
+    /* typing is held to the same rule on every show */
+    AllocStats::beginPhase("interactive");
+}
+
+bool
+Thingylaunch::finish()
+{
+    /* a resident launcher hides until SIGUSR1 instead of exiting */
+    if (!m_resident) {
+        return true;
+    }
+
+    m_x11->hide();
+    m_visible = false;
+
+    /* have the bookmarks ready for the next show */
+    m_reloader->check();
+    return false;
 }
 
 int
 main(int argc, char **argv)
 {
+    atexit(AllocStats::report);
+    atexit(TaskStats::report);
+
+    /* ask a resident launcher to show on our display */
+    if (argc == 2 && strcmp(argv[1], "-show") == 0) {
+        return Thingylaunch::requestShow();
+    }
+
+    /* run by the administrator, from cron or a watcher, rather than by users */
+    if (argc == 3 && strcmp(argv[1], "-build-system-index") == 0) {
+        vector<string> dirs;
+        for (char * dir = strtok(argv[2], ":"); dir; dir = strtok(nullptr, ":")) {
+            dirs.push_back(dir);
+        }
+        if (!SystemIndex::build(dirs, SystemIndex::indexFile())) {
+            perror(SystemIndex::indexFile().c_str());
+            return 1;
+        }
+        return 0;
+    }
+
+    /* index the files below the given roots, from cron or by hand */
+    if (argc == 3 && strcmp(argv[1], "-build-file-index") == 0) {
+        vector<string> roots;
+        for (char * root = strtok(argv[2], ":"); root; root = strtok(nullptr, ":")) {
+            roots.push_back(root);
+        }
+        ThreadPool pool;
+        ThreadPool::Group group;
+        FileIndex previous;
+        bool ok { false };
+        FileIndex::build(roots, &previous, FileIndex::indexFile(), pool, group, [&ok] (bool built) { ok = built; });
+        group.wait();
+        if (!ok) {
+            perror(FileIndex::indexFile().c_str());
+            return 1;
+        }
+        return 0;
+    }
+
+    /* fit the ranking model to what was picked so far, from cron or by hand */
+    if (argc == 2 && strcmp(argv[1], "-train-ranking") == 0) {
+        if (!Ranker::train(Ranker::logFile(), Ranker::modelFile())) {
+            perror(Ranker::modelFile().c_str());
+            return 1;
+        }
+        return 0;
+    }
+
     Thingylaunch t;
     t.run(argc, argv);
 
@@ -166,6 +603,19 @@ Thingylaunch::readOptions(int argc, char **argv)
             setParam(m_fgColorName);
         }
 
+        /* color of a command that can be run, and of one that can't */
+        if (s == "-okfg") {
+            setParam(m_styleColorNames[X11Span::Style_Valid]);
+        }
+        if (s == "-badfg") {
+            setParam(m_styleColorNames[X11Span::Style_Invalid]);
+        }
+
+        /* colors of quoted text, variables, operators, redirections and comments */
+        if (s == "-syntaxfg") {
+            setParam(m_syntaxColorNames);
+        }
+
         /* font foundry */
         if (s == "-fo") {
             setParam(m_fontDesc[0]);
@@ -200,6 +650,37 @@ Thingylaunch::readOptions(int argc, char **argv)
         if (s == "-fpt") {
             setParam(m_fontDesc[6]); 
         }
+
+        /* replay keystrokes from a file, without X */
+        if (s == "-script") {
+            setParam(m_scriptFile);
+        }
+
+        /* stay around after running a command, show again on SIGUSR1 */
+        if (s == "-resident") {
+            m_resident = true;
+        }
+
+        /* switch to existing windows rather than run commands */
+        if (s == "-windows") {
+            m_windowMode = true;
+        }
+
+        /* open files found in the file index rather than run commands */
+        if (s == "-files") {
+            m_fileMode = true;
+        }
+
+        /* pick one of the lines read from stdin, and print it */
+        if (s == "-dmenu") {
+            m_dmenuMode = true;
+        }
+
+        /* a display to serve, may be given several times */
+        if (s == "-display") {
+            m_displayNames.emplace_back();
+            setParam(m_displayNames.back());
+        }
     }
 }
 
@@ -208,28 +689,164 @@ Thingylaunch::eventLoop()
 {
     X11Event ev;
 
-    if (!m_x11->redraw(m_command, m_cursorPos)) {
+    if (!redraw()) {
         die("Couldn't redraw");
     }
 
-    while (m_x11->nextEvent(ev)) {
+    /* the displays first, then our other sources of events */
+    vector<struct pollfd> pfds;
+    for (auto x11 : m_displays) {
+        pfds.push_back({ x11->fileDescriptor(), POLLIN, 0 });
+    }
+    const auto fdReloader = pfds.size();
+    pfds.push_back({ m_reloader ? m_reloader->fileDescriptor() : -1, POLLIN, 0 });
+    const auto fdShow = pfds.size();
+    pfds.push_back({ g_showPipe[0], POLLIN, 0 });
+    const auto fdComp = pfds.size();
+    pfds.push_back({ m_comp.fileDescriptor(), POLLIN, 0 });
+    const auto fdControl = pfds.size();
+    pfds.push_back({ m_controlFd, POLLIN, 0 });
+    const auto fdStream = pfds.size();
+    pfds.push_back({ m_streaming ? STDIN_FILENO : -1, POLLIN, 0 });
+    const auto fdSearch = pfds.size();
+    pfds.push_back({ m_files ? m_files->fileDescriptor() : m_lineSearch ? m_lineSearch->fileDescriptor() : -1, POLLIN, 0 });
+
+    AllocStats::beginPhase("interactive");
+
+    for (;;) {
+
+        /* drain the displays not in use, only the one in use gets keys */
+        for (auto x11 : m_displays) {
+            while (x11 != m_x11 && x11->pollEvent(ev)) { }
+        }
+
+        while (m_x11->pollEvent(ev)) {
 
-        switch (ev.type) {
-            case X11Event::EventType::Evt_Expose:
-                break;
+            auto allocs = AllocStats::count();
 
-            case X11Event::EventType::Evt_KeyPress:
-                if (keypress(ev)) {
+            switch (ev.type) {
+                case X11Event::EventType::Evt_Expose:
+                    break;
+
+                case X11Event::EventType::Evt_KeyPress:
+                    if (m_visible && keypress(ev) && finish()) {
+                        return;
+                    }
+                    break;
+
+                case X11Event::EventType::Evt_Closed:
                     return;
+
+                case X11Event::EventType::Evt_WindowsChanged:
+                    /* coalesce bursts of changes into one refresh, away from key presses */
+                    if (m_windowMode && !m_windowsChanged) {
+                        m_windowsChanged = true;
+                        m_windowsDeadline = chrono::steady_clock::now() + chrono::milliseconds(WindowsDelay);
+                    }
+                    /* replays must not depend on timing */
+                    if (m_windowsChanged && !m_scriptFile.empty()) {
+                        refreshWindows();
+                    }
+                    break;
+
+                case X11Event::EventType::Evt_Other:
+                    break;
+            }
+
+            if (m_visible && !redraw()) {
+                die("Couldn't redraw");
+            }
+
+            if (AllocStats::count() != allocs) {
+                fprintf(stderr, "alloc-stats: key 0x%x allocated %lu times\n",
+                        ev.key, AllocStats::count() - allocs);
+
+                /*
+                 * Typing must never reach the allocator, running a command
+                 * may; the file and dmenu modes start a search per key.
+                 */
+                if (ev.type == X11Event::EventType::Evt_KeyPress && !m_fileMode && !m_dmenuMode &&
+                        AllocStats::inPhase("interactive")) {
+                    abort();
                 }
-                break;
+            }
+        }
+
+        auto now = chrono::steady_clock::now();
+        if (m_windowsChanged && now >= m_windowsDeadline) {
+            refreshWindows();
+            /* its round trips may have queued key presses, which poll won't report */
+            continue;
+        }
+
+        /* wait for the next event, a pending bookmark chord to time out or the windows to be listed again */
+        int timeout { -1 };
+        auto wakeAt = [&] (chrono::steady_clock::time_point deadline) {
+            /* rounded up, not to wake up just short of it */
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - now + chrono::microseconds(999)).count();
+            left = left > 0 ? left : 0;
+            if (timeout == -1 || left < timeout) {
+                timeout = left;
+            }
+        };
+        if (m_chord != Bookmark::Root) {
+            wakeAt(m_chordDeadline);
+        }
+        if (m_windowsChanged) {
+            wakeAt(m_windowsDeadline);
+        }
+
+        int n { poll(pfds.data(), pfds.size(), timeout) };
+        if (n == -1 && errno != EINTR) {
+            die("Couldn't poll the X connection");
+        }
+
+        if (n == 0 && m_chord != Bookmark::Root && chrono::steady_clock::now() >= m_chordDeadline) {
+            if (runBookmark() && finish()) {
+                return;
+            }
+            if (m_visible && !redraw()) {
+                die("Couldn't redraw");
+            }
+        }
+
+        if (pfds[fdReloader].revents & POLLIN) {
+            m_reloader->handleEvents();
+        }
+
+        if (pfds[fdShow].revents & POLLIN) {
+            char buf[64];
+            while (read(g_showPipe[0], buf, sizeof buf) > 0) { }
+            if (!m_visible) {
+                show(m_x11);
+            }
+        }
+
+        if (pfds[fdComp].revents & POLLIN) {
+            m_comp.update();
+        }
 
-            case X11Event::EventType::Evt_Other:
-                break;
+        if (pfds[fdControl].revents & POLLIN) {
+            control();
         }
 
-        if (!m_x11->redraw(m_command, m_cursorPos)) {
-            die("Couldn't redraw");
+        if (pfds[fdStream].revents & (POLLIN | POLLHUP | POLLERR)) {
+            readStream();
+            if (!m_streaming) {
+                pfds[fdStream].fd = -1;
+            }
+        }
+
+        if (pfds[fdSearch].revents & POLLIN) {
+            /* a Tab that found nothing while slices were scoring gets its answer now */
+            if (m_files ? m_files->update() : m_lineSearch->update()) {
+                m_command = m_files ? m_files->next(m_command) : m_lineSearch->next(m_command);
+                m_cursorPos = m_command.length();
+                m_lexer.lex(m_command);
+                if (m_visible && !redraw()) {
+                    die("Couldn't redraw");
+                }
+            }
         }
     }
 }
@@ -242,26 +859,39 @@ Thingylaunch::keypress(X11Event& ev)
         ev.key  = toupper(ev.key);
     }
 
-    /* check for an Alt-key meaning bookmark lookup */
-    if (ev.state & Mod1Mask) {
-        string book = m_book.lookup(ev.key);
-        if (!book.empty()) {
-            m_command = move(book);
-            m_hist.save(m_command);
-            execcmd();
-            return true;
+    /* a bookmark chord in progress takes every key but modifiers */
+    if (m_chord != Bookmark::Root) {
+        if (isModifier(ev.key)) {
+            return false;
         }
+        if (ev.key == XK_Escape || !m_book->walk(m_chord, ev.key)) {
+            m_chord = Bookmark::Root;
+            return false;
+        }
+        return chordStep();
+    }
+
+    /* check for an Alt-key starting a bookmark chord */
+    if ((ev.state & Mod1Mask) && m_book->walk(m_chord, ev.key)) {
+        return chordStep();
     }
 
     switch(ev.key) {
         case XK_Escape:
-            exit(0);
-            break;
+            if (!m_resident) {
+                /* nothing picked, scripts can tell */
+                quit(m_dmenuMode ? 1 : 0);
+            }
+            return true;
 
         case XK_BackSpace:
-            m_comp.reset();
-            if (m_cursorPos != 0)
+            resetCompletion();
+            if (m_cursorPos != 0) {
+                auto size = m_command.size();
                 m_command.erase(--m_cursorPos);
+                m_lexer.edit(m_command, m_cursorPos, size - m_cursorPos, 0);
+            }
+            searchAhead();
             break;
 
         case XK_Left:
@@ -280,12 +910,14 @@ Thingylaunch::keypress(X11Event& ev)
         case XK_KP_Up:
             m_command = m_hist.prev();
             m_cursorPos = m_command.length();
+            m_lexer.lex(m_command);
             break;
 
         case XK_Down:
         case XK_KP_Down:
             m_command = m_hist.next();
             m_cursorPos = m_command.length();
+            m_lexer.lex(m_command);
             break;
 
         case XK_Home:
@@ -299,22 +931,42 @@ Thingylaunch::keypress(X11Event& ev)
             break;
 
         case XK_Return:
-            m_hist.save(m_command);
-            execcmd();
+            if (m_windowMode) {
+                activate();
+            } else if (m_files) {
+                openFile();
+            } else if (m_dmenuMode) {
+                /* what's typed goes out, whether or not it was among the lines */
+                puts(m_command.c_str());
+                fflush(stdout);
+            } else {
+                /* learning from the pick is part of running it */
+                AllocStats::beginPhase("execute");
+                m_comp.chosen(m_command);
+                execcmd();
+            }
             return true;
             break;
 
         case XK_Tab:
         case XK_KP_Tab:
-            m_command = m_comp.next(m_command);
+            if (m_files) {
+                m_command = m_files->next(m_command, !m_scriptFile.empty());
+            } else if (m_lineSearch) {
+                m_command = m_lineSearch->next(m_command, !m_scriptFile.empty());
+            } else {
+                m_command = m_comp.next(m_command);
+            }
             m_cursorPos = m_command.length();
+            m_lexer.lex(m_command);
             break;
 
         case XK_k:
             if (ev.state & ControlMask) {
-                m_comp.reset();
+                resetCompletion();
                 m_command.clear();
                 m_cursorPos = 0;
+                m_lexer.lex(m_command);
                 ev.key = 0; // don't handle the 'k' below
             }
             break;
@@ -332,7 +984,9 @@ Thingylaunch::keypress(X11Event& ev)
                     ++i;
                 }
 
+                auto size = m_command.size();
                 m_command.erase(i, m_cursorPos);
+                m_lexer.edit(m_command, i, size - m_command.size(), 0);
 
                 m_cursorPos = i;
                 ev.key = 0; // don't handle the 'w' below
@@ -350,20 +1004,220 @@ Thingylaunch::keypress(X11Event& ev)
         } else {
             m_command.insert(m_cursorPos, 1, ev.key);
         }
+        m_lexer.edit(m_command, m_cursorPos, 0, 1);
         ++m_cursorPos;
-        m_comp.reset();
+        resetCompletion();
+        searchAhead();
     }
 
     return false;
 }
 
+bool
+Thingylaunch::isModifier(uint16_t key)
+{
+    return (key >= XK_Shift_L && key <= XK_Hyper_R) ||
+           key == XK_Mode_switch || key == XK_ISO_Level3_Shift || key == XK_Num_Lock;
+}
+
+bool
+Thingylaunch::chordStep()
+{
+    /* run at once unless a longer chord could follow */
+    if (m_book->isLeaf(m_chord)) {
+        return runBookmark();
+    }
+
+    m_chordDeadline = chrono::steady_clock::now() + chrono::milliseconds(ChordTimeout);
+    return false;
+}
+
+bool
+Thingylaunch::runBookmark()
+{
+    auto book = m_book->entry(m_chord);
+    m_chord = Bookmark::Root;
+    if (book == nullptr) {
+        return false;
+    }
+
+    /* the command line may outgrow what was reserved for typing */
+    AllocStats::beginPhase("execute");
+    m_command = book->command;
+    execcmd(book->argv);
+    return true;
+}
+
 void
-Thingylaunch::execcmd()
+Thingylaunch::refreshWindows()
 {
+    m_windowsChanged = false;
+
+    /* watching is idempotent, and follows the display in use */
+    m_x11->watchWindows();
+    m_windows.clear();
+    m_x11->listWindows(m_windows);
+    m_comp.addProvider(new WindowProvider { m_windows });
+
+    /* replays must not depend on how fast the providers are */
+    if (!m_scriptFile.empty()) {
+        m_comp.wait();
+    }
+}
+
+void
+Thingylaunch::activate()
+{
+    if (m_command.empty()) {
+        return;
+    }
+
+    /* the exact label, or else the most recent window it's a prefix of */
+    const X11Window * match { nullptr };
+    for (auto w = m_windows.rbegin(); w != m_windows.rend(); ++w) {
+        auto label = WindowProvider::label(*w);
+        if (label == m_command) {
+            match = &*w;
+            break;
+        }
+        if (match == nullptr && label.compare(0, m_command.size(), m_command) == 0) {
+            match = &*w;
+        }
+    }
+
+    if (match) {
+        m_x11->activateWindow(match->id);
+    }
+}
+
+void
+Thingylaunch::openFile()
+{
+    if (m_command.empty()) {
+        return;
+    }
+
+    /* scripted sessions only report what would be opened */
+    if (!m_scriptFile.empty()) {
+        printf("open %s\n", m_command.c_str());
+        return;
+    }
+
+    if (fork()) {
+        return;
+    }
+
+    signal(SIGCHLD, SIG_DFL);
+    execlp(Opener, Opener, m_command.c_str(), static_cast<char *>(nullptr));
+    _exit(127);
+}
+
+void
+Thingylaunch::readStream()
+{
+    m_streaming = m_lines->read();
+}
+
+void
+Thingylaunch::searchAhead()
+{
+    /* start looking for what's just been typed while the next key comes */
+    if (m_files) {
+        m_files->search(m_command);
+    }
+    if (m_lineSearch) {
+        m_lineSearch->search(m_command);
+    }
+}
+
+bool
+Thingylaunch::redraw()
+{
+    m_spans.clear();
+    if (m_windowMode || m_fileMode || m_dmenuMode) {
+        return m_x11->redraw(m_command, m_cursorPos, m_spans);
+    }
+
+    static const X11Span::Style styles[] {
+        X11Span::Style_Default,  /* Tok_Blank */
+        X11Span::Style_Default,  /* Tok_Word */
+        X11Span::Style_Default,  /* Tok_Command, see below */
+        X11Span::Style_Default,  /* Tok_Assign */
+        X11Span::Style_Quoted,   /* Tok_Quoted */
+        X11Span::Style_Variable, /* Tok_Variable */
+        X11Span::Style_Operator, /* Tok_Operator */
+        X11Span::Style_Redirect, /* Tok_Redirect */
+        X11Span::Style_Comment   /* Tok_Comment */
+    };
+
+    /* glyphs are at least a pixel wide, the rest of the line is never seen */
+    for (size_t i = 0; i < m_lexer.count(); ++i) {
+        auto token = m_lexer.token(i);
+        if (token.first >= static_cast<size_t>(WindowWidth)) {
+            break;
+        }
+        auto style = styles[token.kind];
+
+        /* command words, once there's something to check them against */
+        if (token.kind == ShellLexer::Tok_Command) {
+            auto word = m_command.c_str() + token.first;
+            auto len = token.last - token.first;
+            if (memchr(word, '/', len) || memchr(word, '\\', len)) {
+                continue;
+            }
+            if (m_comp.resolves(word, len)) {
+                style = X11Span::Style_Valid;
+            } else if (!m_comp.indexing()) {
+                style = X11Span::Style_Invalid;
+            }
+        }
+
+        if (style != X11Span::Style_Default) {
+            m_spans.push_back(X11Span { token.first, token.last, style });
+        }
+    }
+
+    return m_x11->redraw(m_command, m_cursorPos, m_spans);
+}
+
+void
+Thingylaunch::resetCompletion()
+{
+    m_comp.reset();
+    if (m_files) {
+        m_files->reset();
+    }
+    if (m_lineSearch) {
+        m_lineSearch->reset();
+    }
+}
+
+void
+Thingylaunch::execcmd(char * const * argv)
+{
+    AllocStats::beginPhase("execute");
+
+    m_hist.save(m_command);
+    m_snap.save();
+
+    /* scripted sessions only report what would be run */
+    if (!m_scriptFile.empty()) {
+        puts(m_command.c_str());
+        return;
+    }
+
     if (fork()) {
         return;
     }
 
+    /* don't pass our SIGCHLD disposition on */
+    signal(SIGCHLD, SIG_DFL);
+
+    /* pre-tokenized commands are run directly, without a shell */
+    if (argv) {
+        execvp(argv[0], argv);
+    }
+
     string shell;
     try {
         shell = Util::getEnv("SHELL");
@@ -371,21 +1225,40 @@ Thingylaunch::execcmd()
         shell = "/bin/sh";
     }
 
-    const char * argv[4] { 0 };
-    argv[0] = basename(const_cast<char *>(shell.c_str()));
-    argv[1] = "-c";
-    argv[2] = m_command.c_str();
-    argv[3] = NULL;
+    const char * shellArgv[4] { 0 };
+    shellArgv[0] = basename(const_cast<char *>(shell.c_str()));
+    shellArgv[1] = "-c";
+    shellArgv[2] = m_command.c_str();
+    shellArgv[3] = NULL;
 
-    execv(shell.c_str(), const_cast<char * const *>(argv));
-    /* not reached */
+    execv(shell.c_str(), const_cast<char * const *>(shellArgv));
+    _exit(127);
 }
 
 void
 Thingylaunch::die(string msg)
 {
-    cerr << "Error: " << msg << endl;
-    exit(1);
+    fprintf(stderr, "Error: %s\n", msg.c_str());
+    quit(1);
+}
+
+void
+Thingylaunch::quit(int status)
+{
+    /* tasks under way may be writing a file, the others are dropped */
+    m_comp.stop();
+    m_pool.stop();
+
+    if (m_controlFd != -1) {
+        unlink(controlFile().c_str());
+    }
+
+    /*
+     * What was loaded at startup lives in arenas and mappings, which the
+     * kernel takes back at once: exit skips our destructors, but still
+     * flushes stdio and runs the exit handlers that report statistics.
+     */
+    exit(status);
 }
 
 /*
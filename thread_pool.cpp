@@ -0,0 +1,245 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+using namespace std;
+
+#include "task_stats.h"
+#include "thread_pool.h"
+
+namespace {
+    /* the pool and index of the worker running on this thread, if any */
+    thread_local const void * g_pool { nullptr };
+    thread_local unsigned g_self { 0 };
+}
+
+ThreadPool::Group::Group()
+    : m_pending { 0 }
+{ }
+
+ThreadPool::Group::~Group()
+{
+    wait();
+}
+
+void
+ThreadPool::Group::add()
+{
+    lock_guard<mutex> lock { m_mutex };
+    ++m_pending;
+}
+
+void
+ThreadPool::Group::done()
+{
+    /* notify with the lock held, the waiter may destroy us as soon as it wakes */
+    lock_guard<mutex> lock { m_mutex };
+    if (--m_pending == 0) {
+        m_cond.notify_all();
+    }
+}
+
+bool
+ThreadPool::Group::idle()
+{
+    lock_guard<mutex> lock { m_mutex };
+    return m_pending == 0;
+}
+
+void
+ThreadPool::Group::wait()
+{
+    unique_lock<mutex> lock { m_mutex };
+    m_cond.wait(lock, [this] { return m_pending == 0; });
+}
+
+ThreadPool::ThreadPool(unsigned workers)
+    : m_next { 0 },
+      m_queued { 0 },
+      m_abandon { false },
+      m_stop { false }
+{
+    if (workers == 0) {
+        workers = max(thread::hardware_concurrency(), 1u);
+    }
+
+    for (unsigned i = 0; i < workers; ++i) {
+        m_workers.push_back(new Worker);
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+        m_threads.emplace_back(&ThreadPool::worker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    /* whatever has been queued still runs, groups rely on it */
+    {
+        lock_guard<mutex> lock { m_mutex };
+        m_stop = true;
+    }
+    m_cond.notify_all();
+
+    for (auto& t : m_threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    for (auto w : m_workers) {
+        delete w;
+    }
+}
+
+unsigned
+ThreadPool::workers() const
+{
+    return m_workers.size();
+}
+
+void
+ThreadPool::stop()
+{
+    {
+        lock_guard<mutex> lock { m_mutex };
+        m_stop = true;
+        m_abandon.store(true, memory_order_relaxed);
+    }
+    m_cond.notify_all();
+
+    for (auto& t : m_threads) {
+        t.join();
+    }
+}
+
+void
+ThreadPool::submit(Lane lane, const char * name, function<void()> fn, Group * group)
+{
+    if (group) {
+        group->add();
+    }
+
+    Task task { move(fn), name, group, { } };
+    if (TaskStats::Enabled) {
+        task.queued = chrono::steady_clock::now();
+    }
+
+    /* tasks spawned by a worker stay local, others are spread around */
+    auto target = g_pool == this ? g_self : m_next.fetch_add(1, memory_order_relaxed) % m_workers.size();
+    {
+        lock_guard<mutex> lock { m_workers[target]->mutex };
+        m_workers[target]->lanes[lane].push_back(move(task));
+    }
+
+    {
+        lock_guard<mutex> lock { m_mutex };
+        m_queued.fetch_add(1, memory_order_relaxed);
+    }
+    m_cond.notify_one();
+}
+
+void
+ThreadPool::worker(unsigned self)
+{
+    g_pool = this;
+    g_self = self;
+
+    Task task;
+    Lane lane;
+    for (;;) {
+        if (m_abandon.load(memory_order_relaxed)) {
+            return;
+        }
+
+        if (take(self, task, lane)) {
+            execute(task, lane);
+            continue;
+        }
+
+        unique_lock<mutex> lock { m_mutex };
+        m_cond.wait(lock, [this] { return m_stop || m_queued.load(memory_order_relaxed); });
+        if (m_stop && m_queued.load(memory_order_relaxed) == 0) {
+            return;
+        }
+    }
+}
+
+bool
+ThreadPool::take(unsigned self, Task& task, Lane& lane)
+{
+    auto n = m_workers.size();
+
+    for (int l = 0; l < Lane_Count; ++l) {
+        /* our own newest task first, its data is most likely still in cache */
+        {
+            auto w = m_workers[self];
+            lock_guard<mutex> lock { w->mutex };
+            auto& q = w->lanes[l];
+            if (!q.empty()) {
+                task = move(q.back());
+                q.pop_back();
+                lane = static_cast<Lane>(l);
+                m_queued.fetch_sub(1, memory_order_relaxed);
+                return true;
+            }
+        }
+
+        /* then the oldest task of somebody else */
+        for (unsigned i = 1; i < n; ++i) {
+            auto w = m_workers[(self + i) % n];
+            lock_guard<mutex> lock { w->mutex };
+            auto& q = w->lanes[l];
+            if (!q.empty()) {
+                task = move(q.front());
+                q.pop_front();
+                lane = static_cast<Lane>(l);
+                m_queued.fetch_sub(1, memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void
+ThreadPool::execute(Task& task, Lane lane)
+{
+    if (TaskStats::Enabled) {
+        auto start = chrono::steady_clock::now();
+        task.fn();
+        auto end = chrono::steady_clock::now();
+        TaskStats::record(task.name, lane,
+                chrono::duration_cast<chrono::microseconds>(start - task.queued).count(),
+                chrono::duration_cast<chrono::microseconds>(end - start).count());
+    } else {
+        task.fn();
+    }
+
+    /* release whatever the task captured before telling its owner */
+    task.fn = nullptr;
+    if (task.group) {
+        task.group->done();
+    }
+}
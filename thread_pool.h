@@ -0,0 +1,107 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed set of workers shared by all background work. Each worker owns a
+ * deque per lane: it runs its own tasks newest first and, when it runs dry,
+ * steals the oldest task of another worker. Interactive tasks are always
+ * picked before any background one, wherever they are queued.
+ */
+class ThreadPool {
+    public:
+        enum Lane {
+            Lane_Interactive,
+            Lane_Background,
+            Lane_Count
+        };
+
+        /* counts the tasks submitted on its behalf, so that owners can wait for them */
+        class Group {
+            public:
+                Group();
+                ~Group();
+                void wait();
+                bool idle(); /* nothing submitted on its behalf is still queued or running */
+
+            private:
+                friend class ThreadPool;
+                void add();
+                void done();
+
+            private:
+                std::mutex m_mutex;
+                std::condition_variable m_cond;
+                unsigned m_pending;
+        };
+
+        ThreadPool(unsigned workers = 0); /* 0: one per core */
+        ~ThreadPool();
+        void submit(Lane lane, const char * name, std::function<void()> fn, Group * group = nullptr);
+        unsigned workers() const;
+        /* drop what's queued and wait for what's running, to exit without waiting for groups */
+        void stop();
+
+    private:
+        struct Task {
+            std::function<void()> fn;
+            const char * name;
+            Group * group;
+            std::chrono::steady_clock::time_point queued;
+        };
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> lanes[Lane_Count];
+        };
+
+        void worker(unsigned self);
+        bool take(unsigned self, Task& task, Lane& lane);
+        void execute(Task& task, Lane lane);
+
+    private:
+        std::vector<Worker *> m_workers;
+        std::vector<std::thread> m_threads;
+        std::atomic<unsigned> m_next;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::atomic<unsigned> m_queued;
+        std::atomic<bool> m_abandon;
+        bool m_stop;
+};
+
+#endif /* !THREAD_POOL_H */
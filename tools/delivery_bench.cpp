@@ -0,0 +1,186 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Measures how long a result takes from a worker thread to the event loop:
+ * a producer thread sends timestamps, the consumer sleeps in poll(2) like
+ * Thingylaunch::eventLoop does and records the delay of each one. The SPSC
+ * ring with an eventfd wakeup is compared against a mutex-protected vector
+ * with a pipe.
+ *
+ * Usage: delivery-bench [messages] [interval in microseconds]
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "spsc_ring.h"
+#include "wakeup.h"
+
+namespace {
+
+    typedef chrono::steady_clock Clock;
+
+    long
+    now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    struct RingChannel {
+        SpscRing<long, 1024> ring;
+        Wakeup wake;
+
+        void
+        send(long t)
+        {
+            while (!ring.push(t)) {
+                this_thread::yield();
+            }
+            wake.signal();
+        }
+
+        int fileDescriptor() const { return wake.fileDescriptor(); }
+
+        template <typename F>
+        void
+        receive(F f)
+        {
+            wake.drain();
+            long t;
+            while (ring.pop(t)) {
+                f(t);
+            }
+        }
+    };
+
+    struct MutexChannel {
+        mutex m;
+        vector<long> items;
+        int fds[2];
+
+        MutexChannel()
+        {
+            if (pipe(fds) == -1) {
+                perror("pipe");
+                exit(1);
+            }
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        }
+
+        ~MutexChannel()
+        {
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        void
+        send(long t)
+        {
+            {
+                lock_guard<mutex> lock { m };
+                items.push_back(t);
+            }
+            ssize_t ignored { write(fds[1], "", 1) };
+            (void)ignored;
+        }
+
+        int fileDescriptor() const { return fds[0]; }
+
+        template <typename F>
+        void
+        receive(F f)
+        {
+            char buf[64];
+            while (read(fds[0], buf, sizeof buf) > 0) { }
+            vector<long> taken;
+            {
+                lock_guard<mutex> lock { m };
+                taken.swap(items);
+            }
+            for (auto t : taken) {
+                f(t);
+            }
+        }
+    };
+
+    template <typename Channel>
+    void
+    bench(const char * name, long messages, long interval)
+    {
+        Channel chan;
+        vector<long> delays;
+        delays.reserve(messages);
+
+        thread producer { [&chan, messages, interval] {
+            for (long i = 0; i < messages; ++i) {
+                if (interval) {
+                    this_thread::sleep_for(chrono::microseconds { interval });
+                }
+                chan.send(now());
+            }
+        } };
+
+        struct pollfd pfd { chan.fileDescriptor(), POLLIN, 0 };
+        while (static_cast<long>(delays.size()) < messages) {
+            poll(&pfd, 1, -1);
+            chan.receive([&delays] (long t) { delays.push_back(now() - t); });
+        }
+        producer.join();
+
+        sort(begin(delays), end(delays));
+        auto pct = [&delays] (double p) { return delays[static_cast<size_t>(p * (delays.size() - 1))] / 1000.0; };
+        printf("%-14s p50 %8.2f us  p90 %8.2f us  p99 %8.2f us  max %8.2f us\n",
+                name, pct(0.5), pct(0.9), pct(0.99), pct(1.0));
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    long messages { argc > 1 ? atol(argv[1]) : 20000 };
+    long interval { argc > 2 ? atol(argv[2]) : 50 };
+
+    if (messages <= 0 || interval < 0) {
+        fprintf(stderr, "usage: %s [messages] [interval in microseconds]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%ld messages, one every %ld us\n", messages, interval);
+    bench<RingChannel>("ring+wakeup", messages, interval);
+    bench<MutexChannel>("mutex+pipe", messages, interval);
+
+    return 0;
+}
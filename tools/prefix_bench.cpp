@@ -0,0 +1,150 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Measures how long finding the range of names starting with a prefix takes
+ * in a sorted set of names: two binary searches over the names, against the
+ * Eytzinger-ordered PrefixIndex. Both are checked to find the same
+ * ranges. Queries are prefixes of 1 to 12 characters of random names, so
+ * that most of them match something, and are looked up in random order so
+ * that the caches are as cold as in real typing.
+ *
+ * Usage: prefix-bench [names...]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "prefix_index.h"
+
+namespace {
+
+    typedef chrono::steady_clock Clock;
+
+    bool
+    byName(const Candidate& a, const Candidate& b)
+    {
+        return strcmp(a.name, b.name) < 0;
+    }
+
+    pair<size_t, size_t>
+    binarySearch(const vector<Candidate>& sorted, const char * prefix, size_t len)
+    {
+        auto first = lower_bound(begin(sorted), end(sorted), Candidate { prefix, 0 }, byName);
+        auto last = partition_point(first, end(sorted),
+                [prefix, len] (const Candidate& c) { return strncmp(c.name, prefix, len) == 0; });
+        return { first - begin(sorted), last - begin(sorted) };
+    }
+
+    template <typename F>
+    double
+    time(const vector<string>& queries, F f)
+    {
+        size_t sink { 0 };
+        auto start = Clock::now();
+        for (const auto& q : queries) {
+            auto r = f(q.c_str(), q.size());
+            sink += r.second - r.first;
+        }
+        auto end = Clock::now();
+        if (sink == 0) {
+            puts("");
+        }
+        return chrono::duration_cast<chrono::nanoseconds>(end - start).count() / double(queries.size());
+    }
+
+    void
+    bench(size_t count)
+    {
+        /* names shaped like those in PATH, with a few common stems */
+        mt19937 rng { 42 };
+        static const char * stems[] { "git-", "x", "lib", "gnome-", "kde", "py", "org.freedesktop.", "" };
+        const char alphabet[] { "abcdefghijklmnopqrstuvwxyz0123456789-_." };
+        vector<string> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            string n { stems[rng() % (sizeof stems / sizeof stems[0])] };
+            for (size_t j = 0, len = 3 + rng() % 14; j < len; ++j) {
+                n.push_back(alphabet[rng() % (sizeof alphabet - 1)]);
+            }
+            names.push_back(move(n));
+        }
+        sort(begin(names), end(names));
+        names.erase(unique(begin(names), end(names)), end(names));
+
+        vector<Candidate> sorted;
+        for (const auto& n : names) {
+            sorted.push_back(Candidate { n.c_str(), 0 });
+        }
+        PrefixIndex index;
+        index.build(sorted);
+
+        vector<string> queries;
+        for (size_t i = 0; i < 200000; ++i) {
+            const auto& n = names[rng() % names.size()];
+            queries.push_back(n.substr(0, 1 + rng() % 12));
+        }
+
+        for (const auto& q : queries) {
+            if (binarySearch(sorted, q.c_str(), q.size()) != index.range(sorted, q.c_str(), q.size())) {
+                fprintf(stderr, "mismatch for %s\n", q.c_str());
+                exit(1);
+            }
+        }
+
+        auto bs = time(queries, [&sorted] (const char * p, size_t len) { return binarySearch(sorted, p, len); });
+        auto ey = time(queries, [&sorted, &index] (const char * p, size_t len) { return index.range(sorted, p, len); });
+        printf("%8zu names  lower_bound %7.1f ns  eytzinger %7.1f ns  (x%.2f)\n", sorted.size(), bs, ey, bs / ey);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    vector<size_t> counts;
+    for (int i = 1; i < argc; ++i) {
+        counts.push_back(strtoul(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = { 100000, 1000000 };
+    }
+
+    for (auto n : counts) {
+        if (n == 0) {
+            fprintf(stderr, "usage: %s [names...]\n", argv[0]);
+            return 1;
+        }
+        bench(n);
+    }
+
+    return 0;
+}
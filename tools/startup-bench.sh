@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Build thingylaunch as a plain Release binary, with LTO and with LTO+PGO,
+# and compare the time taken by the scripted session with cold and warm
+# startup snapshots.
+#
+# Usage: startup-bench.sh [runs]
+
+set -e
+
+runs=${1:-200}
+src=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# $1: build name, followed by extra CMake options
+build() {
+    name=$1
+    shift
+    cmake -S "$src" -B "$work/$name" -DCMAKE_BUILD_TYPE=Release "$@" > /dev/null
+    cmake --build "$work/$name" > /dev/null
+}
+
+# $1: build name, $2: cold or warm
+bench() {
+    home=$work/home
+    rm -rf "$home"
+    mkdir -p "$home"
+    printf 'ls -la\nxterm\nsort -u /etc/passwd\n' > "$home/.thingylaunch.history"
+    printf 't xterm\nf firefox\n' > "$home/.thingylaunch.bookmarks"
+
+    start=$(date +%s%N)
+    i=0
+    while [ $i -lt "$runs" ]; do
+        if [ "$2" = cold ]; then
+            rm -f "$home/.thingylaunch.cache"
+        fi
+        HOME=$home "$work/$1/thingylaunch" -script "$src/tools/train.script" > /dev/null
+        i=$((i + 1))
+    done
+    end=$(date +%s%N)
+
+    size=$(wc -c < "$work/$1/thingylaunch")
+    echo "$1 $2: $(( (end - start) / runs / 1000 )) us/run, $size bytes"
+}
+
+build default
+build lto -DUSE_LTO=ON
+build pgo -DUSE_LTO=ON -DPGO=generate
+cmake --build "$work/pgo" --target pgo-train > /dev/null
+build pgo -DUSE_LTO=ON -DPGO=use
+
+for b in default lto pgo; do
+    bench $b cold
+    bench $b warm
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Build the system-wide index of the PATH directories shared by all users.
+# Run it from cron, or with -w to rebuild whenever one of the directories
+# changes (requires inotifywait from inotify-tools).
+#
+# Usage: system-index.sh [-w] [directory...]
+#
+# Without directories, the usual system ones are indexed, plus /opt/*/bin.
+# The thingylaunch binary is taken from $THINGYLAUNCH, or from PATH.
+
+set -e
+
+watch=
+if [ "$1" = -w ]; then
+    watch=1
+    shift
+fi
+
+if [ $# -eq 0 ]; then
+    set -- /bin /sbin /usr/bin /usr/sbin /usr/local/bin /usr/local/sbin /opt/*/bin
+fi
+
+dirs=
+for d in "$@"; do
+    if [ -d "$d" ]; then
+        dirs=${dirs:+$dirs:}$d
+        set -- "$@" "$d"
+    fi
+    shift
+done
+
+tl=${THINGYLAUNCH:-thingylaunch}
+"$tl" -build-system-index "$dirs"
+
+if [ -n "$watch" ]; then
+    # let bursts of changes, e.g. package upgrades, settle before rebuilding;
+    # launchers fall back to scanning a directory changed since the last build
+    while inotifywait -q -q -e create,delete,moved_to,moved_from,attrib "$@"; do
+        sleep 2
+        "$tl" -build-system-index "$dirs"
+    done
+fi
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Run a thingylaunch binary over the scripted training session, with both
+# a cold and a warm startup snapshot, and collect the profiles for PGO.
+#
+# Usage: train.sh <thingylaunch binary> <profile directory> [iterations]
+
+set -e
+
+bin=$1
+profdir=$2
+iterations=${3:-20}
+script=$(dirname "$0")/train.script
+
+if [ -z "$bin" ] || [ -z "$profdir" ]; then
+    echo "usage: $0 <thingylaunch binary> <profile directory> [iterations]" >&2
+    exit 1
+fi
+
+home=$(mktemp -d)
+trap 'rm -rf "$home"' EXIT
+
+printf 'ls -la\nxterm\nsort -u /etc/passwd\n' > "$home/.thingylaunch.history"
+printf 't xterm\nf firefox\n' > "$home/.thingylaunch.bookmarks"
+
+i=0
+while [ $i -lt "$iterations" ]; do
+    # every fourth run starts cold and rescans PATH
+    if [ $((i % 4)) -eq 0 ]; then
+        rm -f "$home/.thingylaunch.cache"
+    fi
+    HOME=$home "$bin" -script "$script" > /dev/null
+    i=$((i + 1))
+done
+
+# clang leaves raw profiles which need to be merged
+if ls "$profdir"/*.profraw > /dev/null 2>&1; then
+    llvm-profdata merge -output="$profdir/default.profdata" "$profdir"/*.profraw
+fi
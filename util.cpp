@@ -23,7 +23,11 @@
  * SUCH DAMAGE.
  */
 
-#include <cstdlib> // getenv
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib> // getenv, mkstemp
+#include <cstring>
 #include <stdexcept>
 using namespace std;
 
@@ -38,3 +42,74 @@ Util::getEnv(string varName)
     }
     return var;
 }
+
+bool
+Util::isExecutable(mode_t mode, uid_t owner, gid_t group, uid_t uid, gid_t gid)
+{
+    return ((mode & S_IFREG) == S_IFREG) &&
+           ((owner == uid && (mode & S_IXUSR) == S_IXUSR) ||
+            (group == gid && (mode & S_IXGRP) == S_IXGRP) ||
+            ((mode & S_IXOTH) == S_IXOTH));
+}
+
+FILE *
+Util::createTemp(const string& fileName, string& tmpFile)
+{
+    /* unique, so that concurrent writers never write to the same file */
+    tmpFile.assign(fileName).append(".XXXXXX");
+    int fd { mkstemp(&tmpFile[0]) };
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    FILE * out { fdopen(fd, "w") };
+    if (out == nullptr) {
+        close(fd);
+        unlink(tmpFile.c_str());
+    }
+    return out;
+}
+
+const char *
+Util::escape(const char * s, string& buf)
+{
+    /* most strings have nothing to escape */
+    if (strpbrk(s, "\t\n\\") == nullptr) {
+        return s;
+    }
+
+    buf.clear();
+    for (; *s; ++s) {
+        switch (*s) {
+            case '\t':
+                buf.append("\\t");
+                break;
+            case '\n':
+                buf.append("\\n");
+                break;
+            case '\\':
+                buf.append("\\\\");
+                break;
+            default:
+                buf.append(1, *s);
+                break;
+        }
+    }
+    return buf.c_str();
+}
+
+char *
+Util::unescape(char * s)
+{
+    char * out { s };
+    for (const char * in = s; *in; ++in) {
+        if (*in == '\\' && in[1]) {
+            ++in;
+            *out++ = *in == 't' ? '\t' : *in == 'n' ? '\n' : *in;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+    return s;
+}
@@ -26,11 +26,31 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <sys/types.h>
+
+#include <cstdio>
 #include <string>
 
 class Util {
     public:
         static std::string getEnv(std::string fileName);
+
+        /* whether a regular file with the given mode and owners can be run by uid:gid */
+        static bool isExecutable(mode_t mode, uid_t owner, gid_t group, uid_t uid, gid_t gid);
+
+        /*
+         * A new file of our own next to fileName, named in tmpFile, to write
+         * its replacement to and rename over it; nullptr on error.
+         */
+        static FILE * createTemp(const std::string& fileName, std::string& tmpFile);
+
+        /* s with tabs, newlines and backslashes escaped, to fit a field of a line */
+        static const char * escape(const char * s, std::string& buf);
+        /* undo escape, in place */
+        static char * unescape(char * s);
+
+        /* initial capacity of command-line buffers, so typing doesn't allocate */
+        static constexpr std::string::size_type CommandReserve { 256 };
 };
 
 #endif /* !UTIL_H */
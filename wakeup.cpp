@@ -0,0 +1,83 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+using namespace std;
+
+#include "wakeup.h"
+
+Wakeup::Wakeup()
+    : m_fds { -1, -1 }
+{
+#ifdef HAVE_EVENTFD
+    /* a single descriptor, read and written as a counter */
+    m_fds[0] = m_fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    if (pipe(m_fds) == 0) {
+        for (auto fd : m_fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+#endif
+}
+
+Wakeup::~Wakeup()
+{
+    if (m_fds[0] != -1) {
+        close(m_fds[0]);
+    }
+    if (m_fds[1] != m_fds[0] && m_fds[1] != -1) {
+        close(m_fds[1]);
+    }
+}
+
+int
+Wakeup::fileDescriptor() const
+{
+    return m_fds[0];
+}
+
+void
+Wakeup::signal()
+{
+    uint64_t one { 1 };
+    ssize_t ignored { write(m_fds[1], &one, sizeof one) };
+    (void)ignored;
+}
+
+void
+Wakeup::drain()
+{
+    /* an eventfd is reset by a single read, a pipe needs emptying */
+    uint64_t buf[8];
+    while (read(m_fds[0], buf, sizeof buf) == sizeof buf) { }
+}
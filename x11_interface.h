@@ -26,27 +26,76 @@
 #ifndef X11INTERFACE_H
 #define X11INTERFACE_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 typedef struct {
     enum EventType {
         Evt_Expose,
         Evt_KeyPress,
+        Evt_Closed,
+        Evt_WindowsChanged, /* the client list, or a client's name, changed */
         Evt_Other
     } type;
     uint16_t key;
     int state;
 } X11Event;
 
+/* A top-level client window, as listed by the window manager */
+struct X11Window {
+    uint32_t id;
+    uint32_t pid;          /* 0 if unknown */
+    std::string name;      /* _NET_WM_NAME, or WM_NAME */
+    std::string wmClass;   /* the instance part of WM_CLASS */
+};
+
+/* A part of the command line drawn in a style of its own */
+struct X11Span {
+    enum Style {
+        Style_Default,
+        Style_Valid,   /* a command that resolves */
+        Style_Invalid, /* a command that doesn't */
+        Style_Quoted,
+        Style_Variable,
+        Style_Operator, /* pipes, lists and subshells */
+        Style_Redirect,
+        Style_Comment,
+        Style_Count
+    };
+
+    std::string::size_type first;
+    std::string::size_type last;
+    Style style;
+};
+
 struct X11Interface {
     virtual ~X11Interface() { }
     virtual bool createWindow(int width, int height) =0;
     virtual bool setupGC(const std::string& bgColor, const std::string& fgColor, const std::string& fontDesc) =0;
     virtual bool grabKeyboard() =0;
-    virtual bool redraw(const std::string& command, std::string::size_type cursorPos) =0;
-    virtual bool nextEvent(X11Event& ev) =0;
+    virtual void show() =0;
+    virtual void hide() =0; /* also releases the keyboard */
+    /* the color of a style other than the default, once the GC is set up */
+    virtual bool setupStyle(X11Span::Style style, const std::string& color) =0;
+    /* spans are sorted and don't overlap, the rest is drawn in the default style */
+    virtual bool redraw(const std::string& command, std::string::size_type cursorPos,
+            const std::vector<X11Span>& spans) =0;
+    /* the descriptor to poll(2) for events, or -1 if events are always ready */
+    virtual int fileDescriptor() =0;
+    /* dequeue an event without blocking, returns false if none is pending */
+    virtual bool pollEvent(X11Event& ev) =0;
+
+    /* the windows in _NET_CLIENT_LIST, with their properties */
+    virtual bool listWindows(std::vector<X11Window>& windows) =0;
+    /* report changes to the windows listed from now on as Evt_WindowsChanged */
+    virtual void watchWindows() =0;
+    /* ask the window manager to switch to a window, through _NET_ACTIVE_WINDOW */
+    virtual bool activateWindow(uint32_t id) =0;
 
-    static X11Interface * create();
+    /* connect to the given display, or to $DISPLAY if empty */
+    static X11Interface * create(const std::string& displayName);
+    static X11Interface * createScripted(const std::string& scriptFile);
 };
 
 #endif /* !X11INTERFACE_H */
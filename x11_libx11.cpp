@@ -23,10 +23,12 @@
  * SUCH DAMAGE.
  */
 
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <stdexcept>
 using namespace std;
@@ -34,46 +36,94 @@ using namespace std;
 #include "x11_interface.h"
 #include "util.h"
 
+namespace {
+
+/* set when a request hits a window destroyed in the meantime */
+bool g_windowGone { false };
+XErrorHandler g_prevHandler { nullptr };
+
+int
+ignoreBadWindow(Display * display, XErrorEvent * error)
+{
+    if (error->error_code == BadWindow) {
+        g_windowGone = true;
+        return 0;
+    }
+    return g_prevHandler(display, error);
+}
+
+}
+
 class X11LibX11 : public X11Interface {
 
     public:
-        X11LibX11();
+        X11LibX11(const string& displayName);
         virtual ~X11LibX11();
         virtual bool createWindow(int width, int height);
         virtual bool setupGC(const string& bgColor, const string& fgColor, const string& fontDesc);
         virtual bool grabKeyboard();
-        virtual bool redraw(const string& command, string::size_type cursorPos);
-        virtual bool nextEvent(X11Event &ev);
+        virtual void show();
+        virtual void hide();
+        virtual bool setupStyle(X11Span::Style style, const string& color);
+        virtual bool redraw(const string& command, string::size_type cursorPos, const vector<X11Span>& spans);
+        virtual int fileDescriptor();
+        virtual bool pollEvent(X11Event &ev);
+        virtual bool listWindows(vector<X11Window>& windows);
+        virtual void watchWindows();
+        virtual bool activateWindow(uint32_t id);
 
     private:
+        enum Atoms {
+            Atom_NetClientList,
+            Atom_NetWmName,
+            Atom_NetWmPid,
+            Atom_NetActiveWindow,
+            Atom_Utf8String,
+            Atom_Count
+        };
+
         string parseFontDesc(const string& fontDesc);
         unsigned long parseColorName(const string& colorName);
+        bool internAtoms();
+        unsigned char * getProperty(Window win, Atom prop, Atom type, unsigned long& count);
 
     private:
         string        m_displayName;
         Display     * m_display;
         GC            m_gc;
         GC            m_rectgc;
+        GC            m_styleGc[X11Span::Style_Count]; /* the default one is m_gc */
         Window        m_win;
         XFontStruct * m_fontInfo;
         int           m_screenNum;
+        Atom          m_atoms[Atom_Count];
+        bool          m_watching;
 
         uint16_t m_width;
         uint16_t m_height;
 };
 
 X11Interface *
-X11Interface::create()
+X11Interface::create(const string& displayName)
 {
-    return new X11LibX11();
+    return new X11LibX11(displayName);
 }
 
-X11LibX11::X11LibX11()
+X11LibX11::X11LibX11(const string& displayName)
+    : m_displayName { displayName },
+      m_styleGc { },
+      m_atoms { },
+      m_watching { false }
 { }
 
 X11LibX11::~X11LibX11()
 {
     XFreeFont(m_display, m_fontInfo);
+    for (auto gc : m_styleGc) {
+        if (gc != m_gc) {
+            XFreeGC(m_display, gc);
+        }
+    }
     XFreeGC(m_display, m_gc);
     XFreeGC(m_display, m_rectgc);
     XUngrabKeyboard(m_display, CurrentTime);
@@ -87,10 +137,12 @@ X11LibX11::createWindow(int width, int height)
     m_width = width;
     m_height = height;
 
-    try {
-        m_displayName = Util::getEnv("DISPLAY");
-    } catch (runtime_error& e) {
-        return false;
+    if (m_displayName.empty()) {
+        try {
+            m_displayName = Util::getEnv("DISPLAY");
+        } catch (runtime_error& e) {
+            return false;
+        }
     }
 
     m_display = XOpenDisplay(m_displayName.c_str());
@@ -121,6 +173,8 @@ X11LibX11::createWindow(int width, int height)
     XSetWMNormalHints(m_display, m_win, win_size_hints);
     XFree(win_size_hints);
 
+    XSelectInput(m_display, m_win, ExposureMask | KeyPressMask);
+
     /* map the window */
     XMapWindow(m_display, m_win);
 
@@ -164,6 +218,26 @@ X11LibX11::setupGC(const string& bgColorName, const string& fgColorName, const s
     XSetForeground(m_display, m_rectgc, bgColor);
     XSetBackground(m_display, m_rectgc, bgColor);
 
+    /* styles look like the default until set up */
+    for (auto& gc : m_styleGc) {
+        gc = m_gc;
+    }
+
+    return true;
+}
+
+bool
+X11LibX11::setupStyle(X11Span::Style style, const string& colorName)
+{
+    GC gc { XCreateGC(m_display, m_win, 0, nullptr) };
+    XCopyGC(m_display, m_gc, GCBackground | GCFont, gc);
+    XSetForeground(m_display, gc, parseColorName(colorName));
+
+    if (m_styleGc[style] != m_gc) {
+        XFreeGC(m_display, m_styleGc[style]);
+    }
+    m_styleGc[style] = gc;
+
     return true;
 }
 
@@ -187,38 +261,84 @@ X11LibX11::grabKeyboard()
     return false;
 }
 
+void
+X11LibX11::show()
+{
+    XMapRaised(m_display, m_win);
+    XFlush(m_display);
+}
+
+void
+X11LibX11::hide()
+{
+    XUngrabKeyboard(m_display, CurrentTime);
+    XUnmapWindow(m_display, m_win);
+    XFlush(m_display);
+}
+
 bool
-X11LibX11::redraw(const string& command, string::size_type cursorPos)
+X11LibX11::redraw(const string& command, string::size_type cursorPos, const vector<X11Span>& spans)
 {
     int font_height { m_fontInfo->ascent + m_fontInfo->descent };
     int cursorLeft { XTextWidth(m_fontInfo, command.c_str(), cursorPos) };
 
     XFillRectangle(m_display, m_win, m_rectgc, 0, 0, m_width, m_height);
     XDrawRectangle(m_display, m_win, m_gc, 0, 0, m_width-1, m_height-1);
-    XDrawString(m_display, m_win, m_gc, 2, font_height + 2, command.c_str(), command.size());
+
+    /* one string per span, and for the text between spans */
+    int left { 2 };
+    string::size_type pos { 0 };
+    auto draw = [&] (string::size_type last, GC gc) {
+        if (last > pos) {
+            XDrawString(m_display, m_win, gc, left, font_height + 2, command.c_str() + pos, last - pos);
+            left += XTextWidth(m_fontInfo, command.c_str() + pos, last - pos);
+            pos = last;
+        }
+    };
+    for (const auto& span : spans) {
+        draw(span.first, m_gc);
+        draw(span.last, m_styleGc[span.style]);
+    }
+    draw(command.size(), m_gc);
     XDrawLine(m_display, m_win, m_gc, 2 + cursorLeft, font_height + 4, 2 + cursorLeft + 10, font_height + 4);
     XFlush(m_display);
 
     return true;
 }
 
+int
+X11LibX11::fileDescriptor()
+{
+    return ConnectionNumber(m_display);
+}
+
 bool
-X11LibX11::nextEvent(X11Event& event)
+X11LibX11::pollEvent(X11Event& event)
 {
     XEvent e;
     XKeyEvent *kev;
     KeySym key_symbol;
     char charPressed;
 
-    event.type = X11Event::EventType::Evt_Other;
+    if (!XPending(m_display)) {
+        return false;
+    }
 
-    XSelectInput(m_display, m_win, ExposureMask | KeyPressMask);
+    event.type = X11Event::EventType::Evt_Other;
 
     XNextEvent(m_display, &e);
     switch(e.type) {
         case Expose:
             event.type = X11Event::EventType::Evt_Expose;
             break;
+        case PropertyNotify:
+            if (e.xproperty.atom == m_atoms[Atom_NetClientList] ||
+                e.xproperty.atom == m_atoms[Atom_NetWmName] ||
+                e.xproperty.atom == XA_WM_NAME)
+            {
+                event.type = X11Event::EventType::Evt_WindowsChanged;
+            }
+            break;
         case KeyPress:
             kev = &e.xkey;
             XLookupString(kev, &charPressed, 1, &key_symbol, NULL);
@@ -232,3 +352,139 @@ X11LibX11::nextEvent(X11Event& event)
 
     return true;
 }
+
+bool
+X11LibX11::internAtoms()
+{
+    if (m_atoms[Atom_NetClientList] != None) {
+        return true;
+    }
+
+    /* a single round trip for all of them */
+    const char * names[Atom_Count] {
+        "_NET_CLIENT_LIST",
+        "_NET_WM_NAME",
+        "_NET_WM_PID",
+        "_NET_ACTIVE_WINDOW",
+        "UTF8_STRING"
+    };
+    return XInternAtoms(m_display, const_cast<char **>(names), Atom_Count, False, m_atoms) != 0;
+}
+
+unsigned char *
+X11LibX11::getProperty(Window win, Atom prop, Atom type, unsigned long& count)
+{
+    Atom actualType;
+    int format;
+    unsigned long after;
+    unsigned char * data { nullptr };
+
+    if (XGetWindowProperty(m_display, win, prop, 0, 1024, False, type,
+                &actualType, &format, &count, &after, &data) != Success || data == nullptr) {
+        count = 0;
+        return nullptr;
+    }
+    if (actualType != type) {
+        XFree(data);
+        count = 0;
+        return nullptr;
+    }
+    return data;
+}
+
+bool
+X11LibX11::listWindows(vector<X11Window>& windows)
+{
+    if (!internAtoms()) {
+        return false;
+    }
+
+    unsigned long count;
+    auto root = RootWindow(m_display, m_screenNum);
+    auto list = reinterpret_cast<Window *>(getProperty(root, m_atoms[Atom_NetClientList], XA_WINDOW, count));
+    if (list == nullptr) {
+        return false;
+    }
+
+    /*
+     * Xlib offers no way to pipeline replies, so each property costs a round
+     * trip here; the XCB backend sends all requests before reading any reply.
+     *
+     * Clients come and go as they please, and the default error handler would
+     * exit on the first one destroyed before its requests are served, so
+     * BadWindow errors are ignored and the windows they hit are skipped.
+     */
+    XSync(m_display, False);
+    g_prevHandler = XSetErrorHandler(ignoreBadWindow);
+    for (unsigned long i = 0; i < count; ++i) {
+        X11Window w { static_cast<uint32_t>(list[i]), 0, { }, { } };
+        unsigned long n;
+        g_windowGone = false;
+
+        /* hear about name changes, too; any error comes in with the replies below */
+        if (m_watching) {
+            XSelectInput(m_display, list[i], PropertyChangeMask);
+        }
+
+        if (auto name = getProperty(list[i], m_atoms[Atom_NetWmName], m_atoms[Atom_Utf8String], n)) {
+            w.name.assign(reinterpret_cast<char *>(name), n);
+            XFree(name);
+        } else if (auto name = getProperty(list[i], XA_WM_NAME, XA_STRING, n)) {
+            w.name.assign(reinterpret_cast<char *>(name), n);
+            XFree(name);
+        }
+
+        if (auto cls = getProperty(list[i], XA_WM_CLASS, XA_STRING, n)) {
+            w.wmClass.assign(reinterpret_cast<char *>(cls), strnlen(reinterpret_cast<char *>(cls), n));
+            XFree(cls);
+        }
+
+        if (auto pid = getProperty(list[i], m_atoms[Atom_NetWmPid], XA_CARDINAL, n)) {
+            w.pid = n ? *reinterpret_cast<unsigned long *>(pid) : 0;
+            XFree(pid);
+        }
+
+        if (!g_windowGone) {
+            windows.push_back(w);
+        }
+    }
+    XSync(m_display, False);
+    XSetErrorHandler(g_prevHandler);
+    XFree(list);
+
+    return true;
+}
+
+void
+X11LibX11::watchWindows()
+{
+    if (!internAtoms()) {
+        return;
+    }
+    m_watching = true;
+    XSelectInput(m_display, RootWindow(m_display, m_screenNum), PropertyChangeMask);
+    XFlush(m_display);
+}
+
+bool
+X11LibX11::activateWindow(uint32_t id)
+{
+    if (!internAtoms()) {
+        return false;
+    }
+
+    XEvent ev;
+    memset(&ev, 0, sizeof ev);
+    ev.xclient.type = ClientMessage;
+    ev.xclient.window = id;
+    ev.xclient.message_type = m_atoms[Atom_NetActiveWindow];
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = 2; /* source indication: a pager */
+    ev.xclient.data.l[1] = CurrentTime;
+
+    auto root = RootWindow(m_display, m_screenNum);
+    bool ok { XSendEvent(m_display, root, False, SubstructureRedirectMask | SubstructureNotifyMask, &ev) != 0 };
+    XFlush(m_display);
+
+    return ok;
+}
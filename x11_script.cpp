@@ -0,0 +1,267 @@
+/*-
+ * Copyright (C) 2016 Pietro Cerutti <gahr@gahr.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <X11/X.h>
+#include <X11/keysym.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+#include "arena.h"
+#include "linereader.h"
+#include "util.h"
+#include "x11_interface.h"
+
+/*
+ * A headless X11Interface that replays keystrokes from a script file, one
+ * line at a time. A line consisting of a key name in angle brackets, e.g.
+ * <Tab> or <C-w>, produces that key; any other line is typed character by
+ * character. A line <Window id pid class name...> adds a client window, as
+ * if the window manager had mapped it. A line <Styles> prints the command
+ * line as last drawn, each span as [style:text]. Used for profile training
+ * and benchmarking.
+ */
+class X11Script : public X11Interface {
+
+    public:
+        X11Script(const string& scriptFile);
+        virtual ~X11Script();
+        virtual bool createWindow(int width, int height);
+        virtual bool setupGC(const string& bgColor, const string& fgColor, const string& fontDesc);
+        virtual bool grabKeyboard();
+        virtual void show();
+        virtual void hide();
+        virtual bool setupStyle(X11Span::Style style, const string& color);
+        virtual bool redraw(const string& command, string::size_type cursorPos, const vector<X11Span>& spans);
+        virtual int fileDescriptor();
+        virtual bool pollEvent(X11Event &ev);
+        virtual bool listWindows(vector<X11Window>& windows);
+        virtual void watchWindows();
+        virtual bool activateWindow(uint32_t id);
+
+    private:
+        bool parseWindow(const char * spec);
+        bool parseKey(const char * name, X11Event& ev);
+        void printStyles() const;
+
+    private:
+        string m_scriptFile;
+        Arena m_arena;
+        LineReader m_script;
+        const char * m_line;
+        vector<X11Window> m_windows;
+        string m_command;
+        vector<X11Span> m_spans;
+};
+
+X11Interface *
+X11Interface::createScripted(const string& scriptFile)
+{
+    return new X11Script(scriptFile);
+}
+
+X11Script::X11Script(const string& scriptFile)
+    : m_scriptFile { scriptFile },
+      m_script { scriptFile, m_arena },
+      m_line { "" }
+{
+    /* redraws copy the command line, which mustn't allocate while typing */
+    m_command.reserve(Util::CommandReserve);
+    m_spans.reserve(Util::CommandReserve);
+}
+
+X11Script::~X11Script()
+{ }
+
+bool
+X11Script::createWindow(int, int)
+{
+    return access(m_scriptFile.c_str(), R_OK) == 0;
+}
+
+bool
+X11Script::setupGC(const string&, const string&, const string&)
+{
+    return true;
+}
+
+bool
+X11Script::grabKeyboard()
+{
+    return true;
+}
+
+void
+X11Script::show()
+{ }
+
+void
+X11Script::hide()
+{ }
+
+bool
+X11Script::setupStyle(X11Span::Style, const string&)
+{
+    return true;
+}
+
+bool
+X11Script::redraw(const string& command, string::size_type, const vector<X11Span>& spans)
+{
+    m_command = command;
+    m_spans = spans;
+    return true;
+}
+
+void
+X11Script::printStyles() const
+{
+    static const char * names[X11Span::Style_Count] { "", "ok", "bad", "quote", "var", "op", "redir", "comment" };
+
+    string::size_type pos { 0 };
+    for (const auto& span : m_spans) {
+        printf("%.*s[%s:%.*s]", static_cast<int>(span.first - pos), m_command.c_str() + pos,
+                names[span.style], static_cast<int>(span.last - span.first), m_command.c_str() + span.first);
+        pos = span.last;
+    }
+    printf("%s\n", m_command.c_str() + pos);
+}
+
+bool
+X11Script::parseKey(const char * name, X11Event& ev)
+{
+    static const struct {
+        const char * name;
+        uint16_t key;
+    } keys[] {
+        { "Tab",       XK_Tab },
+        { "Return",    XK_Return },
+        { "Escape",    XK_Escape },
+        { "BackSpace", XK_BackSpace },
+        { "Left",      XK_Left },
+        { "Right",     XK_Right },
+        { "Up",        XK_Up },
+        { "Down",      XK_Down },
+        { "Home",      XK_Home },
+        { "End",       XK_End }
+    };
+
+    ev.type = X11Event::EventType::Evt_KeyPress;
+    ev.state = 0;
+
+    /* C-x and M-x are Control and Alt (Mod1) combinations */
+    if (strlen(name) == 3 && name[1] == '-' && (name[0] == 'C' || name[0] == 'M')) {
+        ev.state = name[0] == 'C' ? ControlMask : Mod1Mask;
+        ev.key = name[2];
+        return true;
+    }
+
+    for (const auto& k : keys) {
+        if (strcmp(name, k.name) == 0) {
+            ev.key = k.key;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int
+X11Script::fileDescriptor()
+{
+    return -1;
+}
+
+bool
+X11Script::pollEvent(X11Event& event)
+{
+    while (*m_line == '\0') {
+        char * line { m_script.next() };
+        if (line == nullptr) {
+            event.type = X11Event::EventType::Evt_Closed;
+            return true;
+        }
+        m_line = line;
+
+        size_t len { strlen(line) };
+        if (len > 2 && line[0] == '<' && line[len - 1] == '>') {
+            m_line = line + len;
+            line[len - 1] = '\0';
+            if (parseKey(line + 1, event)) {
+                return true;
+            }
+            if (parseWindow(line + 1)) {
+                event.type = X11Event::EventType::Evt_WindowsChanged;
+                return true;
+            }
+            if (strcmp(line + 1, "Styles") == 0) {
+                printStyles();
+            }
+        }
+    }
+
+    event.type = X11Event::EventType::Evt_KeyPress;
+    event.key = static_cast<unsigned char>(*m_line++);
+    event.state = 0;
+
+    return true;
+}
+
+bool
+X11Script::parseWindow(const char * spec)
+{
+    unsigned long id;
+    unsigned long pid;
+    char cls[64];
+    int nameOffset;
+    if (sscanf(spec, "Window %lx %lu %63s %n", &id, &pid, cls, &nameOffset) != 3) {
+        return false;
+    }
+
+    m_windows.push_back(X11Window { static_cast<uint32_t>(id), static_cast<uint32_t>(pid), spec + nameOffset, cls });
+    return true;
+}
+
+bool
+X11Script::listWindows(vector<X11Window>& windows)
+{
+    windows.insert(end(windows), begin(m_windows), end(m_windows));
+    return true;
+}
+
+void
+X11Script::watchWindows()
+{ }
+
+bool
+X11Script::activateWindow(uint32_t id)
+{
+    /* scripted sessions only report what would be done */
+    printf("activate 0x%x\n", id);
+    return true;
+}
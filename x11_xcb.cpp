@@ -29,6 +29,7 @@
 #include <xcb/xproto.h>
 
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 using namespace std;
 
@@ -37,20 +38,39 @@ using namespace std;
 class X11XCB : public X11Interface {
 
     public:
-        X11XCB();
+        X11XCB(const string& displayName);
         virtual ~X11XCB();
         virtual bool createWindow(int width, int height);
         virtual bool setupGC(const string& bgColor, const string& fgColor, const string& fontDesc);
         virtual bool grabKeyboard();
-        virtual bool redraw(const string& command, string::size_type cursorPos);
-        virtual bool nextEvent(X11Event &ev);
+        virtual void show();
+        virtual void hide();
+        virtual bool setupStyle(X11Span::Style style, const string& color);
+        virtual bool redraw(const string& command, string::size_type cursorPos, const vector<X11Span>& spans);
+        virtual int fileDescriptor();
+        virtual bool pollEvent(X11Event &ev);
+        virtual bool listWindows(vector<X11Window>& windows);
+        virtual void watchWindows();
+        virtual bool activateWindow(uint32_t id);
 
     private:
+        enum Atoms {
+            Atom_NetClientList,
+            Atom_NetWmName,
+            Atom_NetWmPid,
+            Atom_NetActiveWindow,
+            Atom_Utf8String,
+            Atom_Count
+        };
+
         string parseFontDesc(const string& fontDesc);
         uint32_t parseColorName(const string& colorName);
-        xcb_query_text_extents_reply_t * getTextExtent(const string& s, int len);
+        bool queryFont();
+        int textWidth(const string& s, string::size_type first, string::size_type last) const;
+        bool internAtoms();
 
     private:
+        string              m_displayName;
         xcb_connection_t  * m_connection;
         xcb_screen_t      * m_screen;
         xcb_window_t        m_win;
@@ -58,24 +78,40 @@ class X11XCB : public X11Interface {
         xcb_font_t          m_font;
         xcb_gcontext_t      m_fgGc;
         xcb_gcontext_t      m_bgGc;
+        xcb_gcontext_t      m_styleGc[X11Span::Style_Count]; /* the default one is m_fgGc */
+        uint32_t            m_bgColor;
+        int16_t             m_fontAscent;
+        int16_t             m_advance[256]; /* of each character, to measure text without a round trip */
+        xcb_atom_t          m_atoms[Atom_Count];
+        bool                m_watching;
 
         uint16_t m_width;
         uint16_t m_height;
 };
 
 X11Interface *
-X11Interface::create()
+X11Interface::create(const string& displayName)
 {
-    return new X11XCB();
+    return new X11XCB(displayName);
 }
 
-X11XCB::X11XCB()
+X11XCB::X11XCB(const string& displayName)
+    : m_displayName { displayName },
+      m_styleGc { },
+      m_advance { },
+      m_atoms { },
+      m_watching { false }
 { }
 
 X11XCB::~X11XCB()
 {
     free(m_keysyms);
     xcb_close_font(m_connection, m_font);
+    for (auto gc : m_styleGc) {
+        if (gc != m_fgGc) {
+            xcb_free_gc(m_connection, gc);
+        }
+    }
     xcb_free_gc(m_connection, m_fgGc);
     xcb_free_gc(m_connection, m_bgGc);
     xcb_destroy_window(m_connection, m_win);
@@ -88,11 +124,17 @@ X11XCB::createWindow(int width, int height)
     m_width = width;
     m_height = height;
 
-    /* open connection to the display server */
-    if ((m_connection = xcb_connect(NULL, NULL)) == nullptr) {
+    /* open connection to the display server, on the screen it names */
+    int screenNum { 0 };
+    m_connection = xcb_connect(m_displayName.empty() ? nullptr : m_displayName.c_str(), &screenNum);
+    if (m_connection == nullptr || xcb_connection_has_error(m_connection)) {
         return false;
     }
-    m_screen = xcb_setup_roots_iterator(xcb_get_setup(m_connection)).data;
+    auto roots = xcb_setup_roots_iterator(xcb_get_setup(m_connection));
+    for (; screenNum > 0 && roots.rem > 1; --screenNum) {
+        xcb_screen_next(&roots);
+    }
+    m_screen = roots.data;
 
     /* allocate keysyms */
     m_keysyms = xcb_key_symbols_alloc(m_connection);
@@ -151,19 +193,35 @@ X11XCB::parseColorName(const string& colorName)
      return color;
 }
 
-xcb_query_text_extents_reply_t *
-X11XCB::getTextExtent(const string& s, int len)
+bool
+X11XCB::queryFont()
 {
-    xcb_char2b_t chars[len];
-    for (int i = 0; i < len; ++i) {
-        chars[i].byte1 = 0;
-        chars[i].byte2 = s[i];
+    auto reply = xcb_query_font_reply(m_connection, xcb_query_font(m_connection, m_font), nullptr);
+    if (reply == nullptr) {
+        return false;
     }
 
-    auto cookie = xcb_query_text_extents(m_connection, m_font, len, chars);
-    auto reply = xcb_query_text_extents_reply(m_connection, cookie, NULL);
+    /* fonts whose characters are all alike don't list them */
+    m_fontAscent = reply->font_ascent;
+    auto infos = xcb_query_font_char_infos(reply);
+    auto count = xcb_query_font_char_infos_length(reply);
+    for (int c = 0; c < 256; ++c) {
+        int i { c - reply->min_char_or_byte2 };
+        m_advance[c] = i >= 0 && i < count ? infos[i].character_width : reply->max_bounds.character_width;
+    }
+    free(reply);
+
+    return true;
+}
 
-    return reply;
+int
+X11XCB::textWidth(const string& s, string::size_type first, string::size_type last) const
+{
+    int width { 0 };
+    for (auto i = first; i < last; ++i) {
+        width += m_advance[static_cast<unsigned char>(s[i])];
+    }
+    return width;
 }
 
 bool
@@ -172,13 +230,14 @@ X11XCB::setupGC(const string& bgColorName, const string& fgColorName, const stri
     /* open font */
     m_font = xcb_generate_id(m_connection);
     auto fontCookie = xcb_open_font_checked(m_connection, m_font, fontDesc.size(), fontDesc.c_str());
-    if (xcb_request_check(m_connection, fontCookie)) {
+    if (xcb_request_check(m_connection, fontCookie) || !queryFont()) {
         return false;
     }
 
     /* resolve colors */
     auto bgColor = parseColorName(bgColorName);
     auto fgColor = parseColorName(fgColorName);
+    m_bgColor = bgColor;
 
     /* create gc */
     uint32_t gcMask { XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_LINE_WIDTH | XCB_GC_LINE_STYLE | XCB_GC_CAP_STYLE | XCB_GC_JOIN_STYLE | XCB_GC_FONT };
@@ -199,6 +258,29 @@ X11XCB::setupGC(const string& bgColorName, const string& fgColorName, const stri
         return false;
     }
 
+    /* styles look like the default until set up */
+    for (auto& gc : m_styleGc) {
+        gc = m_fgGc;
+    }
+
+    return true;
+}
+
+bool
+X11XCB::setupStyle(X11Span::Style style, const string& colorName)
+{
+    uint32_t gcMask { XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_FONT };
+    uint32_t gcValues[] { parseColorName(colorName), m_bgColor, m_font };
+    auto gc = xcb_generate_id(m_connection);
+    if (xcb_request_check(m_connection, xcb_create_gc_checked(m_connection, gc, m_win, gcMask, gcValues))) {
+        return false;
+    }
+
+    if (m_styleGc[style] != m_fgGc) {
+        xcb_free_gc(m_connection, m_styleGc[style]);
+    }
+    m_styleGc[style] = gc;
+
     return true;
 }
 
@@ -226,8 +308,25 @@ X11XCB::grabKeyboard()
     return false;
 }
 
+void
+X11XCB::show()
+{
+    uint32_t stackMode[] { XCB_STACK_MODE_ABOVE };
+    xcb_configure_window(m_connection, m_win, XCB_CONFIG_WINDOW_STACK_MODE, stackMode);
+    xcb_map_window(m_connection, m_win);
+    xcb_flush(m_connection);
+}
+
+void
+X11XCB::hide()
+{
+    xcb_ungrab_keyboard(m_connection, XCB_CURRENT_TIME);
+    xcb_unmap_window(m_connection, m_win);
+    xcb_flush(m_connection);
+}
+
 bool
-X11XCB::redraw(const string& command, string::size_type cursorPos)
+X11XCB::redraw(const string& command, string::size_type cursorPos, const vector<X11Span>& spans)
 {
     /* draw the background rectangle */
     xcb_rectangle_t extRect { 0, 0, m_width, m_height };
@@ -239,31 +338,34 @@ X11XCB::redraw(const string& command, string::size_type cursorPos)
     xcb_rectangle_t intRect { 0, 0, w, h };
     auto fgCookie = xcb_poly_rectangle_checked(m_connection, m_win, m_fgGc, 1, &intRect);
 
-    /* get text size */
-    auto wholeExt = getTextExtent(command, command.size());
-    auto partialExt = getTextExtent(command, cursorPos);
-
-    /* draw the text */
-    auto txtCookie = xcb_image_text_8_checked(m_connection, command.size(), m_win, m_fgGc, 2,
-        m_height/2 + wholeExt->font_ascent/2, command.c_str());
+    /* draw the text, one request per span and for the text between spans, unchecked */
+    int16_t left { 2 };
+    int16_t baseline = m_height/2 + m_fontAscent/2;
+    string::size_type pos { 0 };
+    auto draw = [&] (string::size_type last, xcb_gcontext_t gc) {
+        if (last > pos) {
+            xcb_image_text_8(m_connection, last - pos, m_win, gc, left, baseline, command.c_str() + pos);
+            left += textWidth(command, pos, last);
+            pos = last;
+        }
+    };
+    for (const auto& span : spans) {
+        draw(span.first, m_fgGc);
+        draw(span.last, m_styleGc[span.style]);
+    }
+    draw(command.size(), m_fgGc);
 
     /* draw the cursor */
-    int16_t cursorLeft = partialExt->overall_width + 2;
+    int16_t cursorLeft = textWidth(command, 0, cursorPos) + 2;
     xcb_rectangle_t curRect = { cursorLeft, 6, 1, 16 };
     auto curCookie = xcb_poly_fill_rectangle_checked(m_connection, m_win, m_fgGc, 1, &curRect);
 
-    free(wholeExt);
-    free(partialExt);
-
     if (xcb_request_check(m_connection, bgCookie)) {
         return false;
     }
     if (xcb_request_check(m_connection, fgCookie)) {
         return false;
     }
-    if (xcb_request_check(m_connection, txtCookie)) {
-        return false;
-    }
     if (xcb_request_check(m_connection, curCookie)) {
         return false;
     }
@@ -273,16 +375,26 @@ X11XCB::redraw(const string& command, string::size_type cursorPos)
     return true;
 }
 
+int
+X11XCB::fileDescriptor()
+{
+    return xcb_get_file_descriptor(m_connection);
+}
+
 bool
-X11XCB::nextEvent(X11Event& event)
+X11XCB::pollEvent(X11Event& event)
 {
     xcb_generic_event_t * e;
     xcb_key_press_event_t * kev;
 
     event.type = X11Event::EventType::Evt_Other;
 
-    e = xcb_wait_for_event(m_connection);
+    e = xcb_poll_for_event(m_connection);
     if (!e) {
+        if (xcb_connection_has_error(m_connection)) {
+            event.type = X11Event::EventType::Evt_Closed;
+            return true;
+        }
         return false;
     }
 
@@ -290,6 +402,16 @@ X11XCB::nextEvent(X11Event& event)
         case XCB_EXPOSE:
             event.type = X11Event::EventType::Evt_Expose;
             break;
+        case XCB_PROPERTY_NOTIFY: {
+            auto pev = reinterpret_cast<xcb_property_notify_event_t *>(e);
+            if (pev->atom == m_atoms[Atom_NetClientList] ||
+                pev->atom == m_atoms[Atom_NetWmName] ||
+                pev->atom == XCB_ATOM_WM_NAME)
+            {
+                event.type = X11Event::EventType::Evt_WindowsChanged;
+            }
+            break;
+        }
         case XCB_KEY_PRESS:
             kev = reinterpret_cast<xcb_key_press_event_t *>(e);
             event.type = X11Event::EventType::Evt_KeyPress;
@@ -305,3 +427,158 @@ X11XCB::nextEvent(X11Event& event)
 
     return true;
 }
+
+bool
+X11XCB::internAtoms()
+{
+    if (m_atoms[Atom_NetClientList] != XCB_ATOM_NONE) {
+        return true;
+    }
+
+    static const char * names[Atom_Count] {
+        "_NET_CLIENT_LIST",
+        "_NET_WM_NAME",
+        "_NET_WM_PID",
+        "_NET_ACTIVE_WINDOW",
+        "UTF8_STRING"
+    };
+
+    /* send all requests before waiting for the first reply */
+    xcb_intern_atom_cookie_t cookies[Atom_Count];
+    for (int i = 0; i < Atom_Count; ++i) {
+        cookies[i] = xcb_intern_atom(m_connection, 0, strlen(names[i]), names[i]);
+    }
+
+    bool ok { true };
+    for (int i = 0; i < Atom_Count; ++i) {
+        auto reply = xcb_intern_atom_reply(m_connection, cookies[i], nullptr);
+        if (reply) {
+            m_atoms[i] = reply->atom;
+            free(reply);
+        } else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool
+X11XCB::listWindows(vector<X11Window>& windows)
+{
+    if (!internAtoms()) {
+        return false;
+    }
+
+    auto listCookie = xcb_get_property(m_connection, 0, m_screen->root, m_atoms[Atom_NetClientList],
+            XCB_ATOM_WINDOW, 0, 4096);
+    auto listReply = xcb_get_property_reply(m_connection, listCookie, nullptr);
+    if (listReply == nullptr) {
+        return false;
+    }
+
+    auto ids = static_cast<xcb_window_t *>(xcb_get_property_value(listReply));
+    size_t count { listReply->type == XCB_ATOM_WINDOW ? xcb_get_property_value_length(listReply) / sizeof *ids : 0 };
+
+    /*
+     * Pipeline the requests: the names, classes and pids of all clients are
+     * asked for in one go, and the replies collected afterwards, so the whole
+     * list costs a single round trip instead of one per property.
+     */
+    enum { Prop_NetName, Prop_Name, Prop_Class, Prop_Pid, Prop_Count };
+    vector<xcb_get_property_cookie_t> cookies(count * Prop_Count);
+    for (size_t i = 0; i < count; ++i) {
+        auto c = &cookies[i * Prop_Count];
+        c[Prop_NetName] = xcb_get_property(m_connection, 0, ids[i], m_atoms[Atom_NetWmName], m_atoms[Atom_Utf8String], 0, 1024);
+        c[Prop_Name] = xcb_get_property(m_connection, 0, ids[i], XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 1024);
+        c[Prop_Class] = xcb_get_property(m_connection, 0, ids[i], XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 1024);
+        c[Prop_Pid] = xcb_get_property(m_connection, 0, ids[i], m_atoms[Atom_NetWmPid], XCB_ATOM_CARDINAL, 0, 1);
+
+        /* hear about name changes, too */
+        if (m_watching) {
+            uint32_t mask[] { XCB_EVENT_MASK_PROPERTY_CHANGE };
+            xcb_change_window_attributes(m_connection, ids[i], XCB_CW_EVENT_MASK, mask);
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        X11Window w { ids[i], 0, { }, { } };
+
+        /* no reply means an error, e.g. the client was destroyed in the meantime */
+        bool gone { false };
+        for (int p = 0; p < Prop_Count; ++p) {
+            auto reply = xcb_get_property_reply(m_connection, cookies[i * Prop_Count + p], nullptr);
+            if (reply == nullptr) {
+                gone = true;
+                continue;
+            }
+            auto value = static_cast<const char *>(xcb_get_property_value(reply));
+            size_t len = xcb_get_property_value_length(reply);
+            if (reply->type != XCB_ATOM_NONE && len) {
+                switch (p) {
+                    case Prop_NetName:
+                        w.name.assign(value, len);
+                        break;
+                    case Prop_Name:
+                        if (w.name.empty()) {
+                            w.name.assign(value, len);
+                        }
+                        break;
+                    case Prop_Class:
+                        w.wmClass.assign(value, strnlen(value, len));
+                        break;
+                    case Prop_Pid:
+                        if (len >= sizeof w.pid) {
+                            memcpy(&w.pid, value, sizeof w.pid);
+                        }
+                        break;
+                }
+            }
+            free(reply);
+        }
+
+        if (!gone) {
+            windows.push_back(w);
+        }
+    }
+
+    free(listReply);
+    return true;
+}
+
+void
+X11XCB::watchWindows()
+{
+    if (!internAtoms()) {
+        return;
+    }
+    m_watching = true;
+    uint32_t mask[] { XCB_EVENT_MASK_PROPERTY_CHANGE };
+    xcb_change_window_attributes(m_connection, m_screen->root, XCB_CW_EVENT_MASK, mask);
+    xcb_flush(m_connection);
+}
+
+bool
+X11XCB::activateWindow(uint32_t id)
+{
+    if (!internAtoms()) {
+        return false;
+    }
+
+    xcb_client_message_event_t ev;
+    memset(&ev, 0, sizeof ev);
+    ev.response_type = XCB_CLIENT_MESSAGE;
+    ev.format = 32;
+    ev.window = id;
+    ev.type = m_atoms[Atom_NetActiveWindow];
+    ev.data.data32[0] = 2; /* source indication: a pager */
+    ev.data.data32[1] = XCB_CURRENT_TIME;
+
+    auto cookie = xcb_send_event_checked(m_connection, 0, m_screen->root,
+            XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY,
+            reinterpret_cast<const char *>(&ev));
+    if (auto error = xcb_request_check(m_connection, cookie)) {
+        free(error);
+        return false;
+    }
+    return true;
+}